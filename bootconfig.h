@@ -0,0 +1,86 @@
+/*
+ * bootconfig.h - part of USBasp bootloader
+ *
+ * Description....: Build time options of the bootloader
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __bootconfig_h_included__
+#define __bootconfig_h_included__
+
+#ifndef BOOT_CFG_AB_SLOTS
+#define BOOT_CFG_AB_SLOTS       0
+#endif
+/* Define this to 1 to split the application area into two slots (see
+ * slots.h). Applications then have to be linked for the slot they are
+ * uploaded to, and plain avrdude uploads to address 0 are refused, so this
+ * is off by default.
+ */
+
+#ifndef BOOT_CFG_STAGING
+#define BOOT_CFG_STAGING        0
+#endif
+/* Define this to 1 to reserve the upper half of the application area as a
+ * staging region (see stage.h). The application stores a new image there
+ * and sets the commit flag in EEPROM, the bootloader copies it over on the
+ * next reset. Applications are limited to the lower half.
+ */
+
+#ifndef BOOT_CFG_UART
+#define BOOT_CFG_UART           0
+#endif
+/* Define this to 1 to also accept the bootloader protocol framed on UART0
+ * (see uartlink.h), whichever of USB and UART sees a request first is used
+ * for the rest of the session. Define it to 2 to use only the UART. UART0
+ * then can't be used for the debug output of uart.c.
+ */
+
+#ifndef BOOT_CFG_UART_BAUD
+#define BOOT_CFG_UART_BAUD      750000
+#endif
+/* Baud rate of the UART transport. It is generated with U2X set, so with the
+ * 12 MHz crystal 1500000, 750000 and 500000 are exact, and FTDI adapters hit
+ * the first two exactly as well.
+ */
+
+#ifndef BOOT_CFG_HID
+#define BOOT_CFG_HID            0
+#endif
+/* Define this to 1 to make the device a vendor defined HID (VID/PID
+ * 16c0/05df) which needs no driver on the host. Flash pages are moved in
+ * feature reports (see hid.h), the vendor requests keep working for hosts
+ * that can send them. This file is also included from usbconfig.h.
+ */
+
+#ifndef BOOT_CFG_USB_SHARE
+#define BOOT_CFG_USB_SHARE      0
+#endif
+/* Set through SHARE_USB=1 in the Makefile, which also moves the bootloader's
+ * RAM out of the application's way. Exports the V-USB driver to the
+ * application through the service table (see services.h).
+ */
+
+#ifndef BOOT_CFG_SELFUPDATE
+#if BOOT_CFG_AB_SLOTS || BOOT_CFG_STAGING
+#define BOOT_CFG_SELFUPDATE     0
+#else
+#define BOOT_CFG_SELFUPDATE     1
+#endif
+#endif
+/* Define this to 0 to drop USBASP_FUNC_SELFUPDATE. The copier (see
+ * selfupdate.h) takes up two pages at the end of the boot section. The new
+ * image is staged at USBASP_SELFUPDATE_START, which belongs to slot B or to
+ * the staging region in the builds above, so it is off by default there.
+ */
+
+#if BOOT_CFG_AB_SLOTS && BOOT_CFG_STAGING
+#error "BOOT_CFG_AB_SLOTS and BOOT_CFG_STAGING both use the upper half of the application area"
+#endif
+
+#if BOOT_CFG_SELFUPDATE && (BOOT_CFG_AB_SLOTS || BOOT_CFG_STAGING)
+#error "BOOT_CFG_SELFUPDATE stages the new bootloader in the upper half of the application area"
+#endif
+
+#endif /* __bootconfig_h_included__ */
@@ -0,0 +1,732 @@
+/*
+ * engine.c - part of USBasp bootloader
+ *
+ * Description....: Transport independent programming engine
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/boot.h>
+#include <string.h>
+
+#include "engine.h"
+#include "usbasp.h"
+#include "usbdrv.h"
+#include "flash.h"
+#include "bootconfig.h"
+#include "slots.h"
+#include "journal.h"
+#include "selfupdate.h"
+
+#define MODULE_NAME "engn"
+#ifndef LOGGING_ENABLE
+#define LOGGING_ENABLE 1
+#endif
+#include "logging.h"
+
+static uchar replyBuffer[32];
+
+static uchar prog_state = PROG_STATE_IDLE;
+static uchar prog_sck = USBASP_ISP_SCK_AUTO;
+
+static uchar prog_address_newmode = 0;
+static unsigned long prog_address;
+static unsigned int prog_nbytes = 0;
+static uchar prog_blockflags;
+
+static uchar rle_token[3];
+static uchar rle_tokenlen;
+static uchar rle_tokenpos;
+static unsigned int rle_budget;
+
+static uchar sg_header[USBASP_SG_RECORDSIZE];
+static uchar sg_headerpos;
+static unsigned int sg_remaining;
+static uchar sg_ranges[USBASP_SG_MAXRANGES * USBASP_SG_RECORDSIZE];
+static uchar sg_rangecount;
+static uchar sg_index;
+/* READFLASH_SG position in the read list, kept from one request to the next */
+static unsigned long sg_readaddress;
+static unsigned int sg_readremaining;
+
+static uchar fingerprint_valid = 1;
+static uint16_t fingerprint_pages;
+static uchar fingerprint_buildid[USBASP_BUILDID_LEN];
+
+static uchar session_data[8];
+static uchar session_datapos;
+
+#if BOOT_CFG_SELFUPDATE
+static uint16_t selfupdate_pages;
+static uchar selfupdate_crc[4];
+static uchar selfupdate_crcpos;
+#endif
+
+#if BOOT_CFG_AB_SLOTS
+static uint16_t slot_pages;
+static uchar slot_crc[4];
+static uchar slot_crcpos;
+#endif
+
+/* filled in from the signature row or EEPROM by engineInit() */
+static uchar serialBytes[USBASP_SERIAL_LEN];
+
+static uchar engine_finished = 0;
+
+// encode the next run or literal at prog_address into rle_token, returns 0
+// (consuming nothing) if the token would not fit in what is left of the reply
+static uchar rleNextToken(void) {
+	uchar value = flashReadByte(prog_address);
+	uchar run = 1;
+
+	while ((run < prog_nbytes) && (run < 255) && (flashReadByte(prog_address + run) == value)) {
+		run++;
+	}
+
+	if ((run >= USBASP_RLE_MINRUN) || (value == USBASP_RLE_ESCAPE)) {
+		rle_token[0] = USBASP_RLE_ESCAPE;
+		rle_token[1] = run;
+		rle_token[2] = value;
+		rle_tokenlen = 3;
+	} else {
+		rle_token[0] = value;
+		rle_tokenlen = 1;
+		run = 1;
+	}
+
+	if (rle_tokenlen > rle_budget) {
+		rle_tokenlen = 0;
+		return 0;
+	}
+
+	rle_budget -= rle_tokenlen;
+	rle_tokenpos = 0;
+	prog_address += run;
+	prog_nbytes -= run;
+	return 1;
+}
+
+// the stored fingerprint no longer describes flash once it is modified
+static void fingerprintInvalidate(void) {
+	usbaspFingerprint_t* record = (void*)USBASP_EEPROM_FINGERPRINT;
+
+	if (fingerprint_valid) {
+		boot_spm_busy_wait();
+		eeprom_update_word(&record->pages, USBASP_FINGERPRINT_NONE);
+		fingerprint_valid = 0;
+	}
+}
+
+static void fingerprintStore(void) {
+	usbaspFingerprint_t fingerprint;
+
+	flashIdle();
+	fingerprint.crc = flashCrc32(0, (unsigned long) fingerprint_pages * SPM_PAGESIZE);
+	fingerprint.pages = fingerprint_pages;
+	memcpy(fingerprint.buildid, fingerprint_buildid, USBASP_BUILDID_LEN);
+	eeprom_update_block(&fingerprint, (void*)USBASP_EEPROM_FINGERPRINT, sizeof(fingerprint));
+	fingerprint_valid = 1;
+}
+
+// load address and length of a scatter-gather record, every byte is cast
+// before shifting since a 16 bit int would sign-extend record[1] << 8
+static void sgLoadRecord(uchar* record, unsigned long* address, unsigned int* length) {
+	*address = ((unsigned long) record[2] << 16) | ((unsigned long) record[1] << 8) | record[0];
+	*length = (record[4] << 8) | record[3];
+}
+
+uint16_t engineSetup(uchar* data, uchar** reply) {
+
+	usbRequest_t* rq = (void*)data;
+
+	uint16_t len = 0;
+	uchar i;
+
+	// log_print("request type: %x", rq->bmRequestType);
+
+	if (rq->bRequest == USBASP_FUNC_CONNECT) {
+		log_print("connecting");
+
+		/* set compatibility mode of address delivering */
+		prog_address_newmode = 0;
+
+		ledRedOn();
+
+	} else if (rq->bRequest == USBASP_FUNC_DISCONNECT) {
+		log_print("disconnecting");
+		engine_finished = 1;
+		ledRedOff();
+
+	} else if (rq->bRequest == USBASP_FUNC_TRANSMIT) {
+		log_print("transmit request: %02x %02x %02x %02x ", data[2], data[3], data[4], data[5]);
+
+		// [0x30, 0x00, [byte], 0x00] - respond with signature bytes
+		switch (data[2])
+		{
+		case 0xac:
+			if (data[3] == 0x80) { // chip erase, runs in the background from the main loop
+				fingerprintInvalidate();
+				flashEraseStart();
+			}
+			len = 4;
+			break;
+		case 0xf0: // poll rdy/bsy
+			replyBuffer[3] = flashEraseBusy();
+			len = 4;
+			break;
+		case 0x30:
+			/* code */
+			replyBuffer[3] = boot_signature_byte_get(data[4] * 2);
+			len = 4;
+			break;
+		case 0x58:
+			switch (data[3]) {
+			case 0x00:
+				replyBuffer[3] = boot_lock_fuse_bits_get(GET_LOCK_BITS);
+				break;
+			case 0x08:
+				replyBuffer[3] = boot_lock_fuse_bits_get(GET_HIGH_FUSE_BITS);
+				break;
+			default:
+				break;
+			}
+			len = 4;
+			break;
+		case 0x50:
+			switch (data[3]) {
+			case 0x00:
+				replyBuffer[3] = boot_lock_fuse_bits_get(GET_LOW_FUSE_BITS);
+				break;
+			case 0x08:
+				replyBuffer[3] = boot_lock_fuse_bits_get(GET_EXTENDED_FUSE_BITS);
+				break;
+
+			default:
+				break;
+			}
+			len = 4;
+			break;
+		default:
+			break;
+		}
+
+
+	} else if (rq->bRequest == USBASP_FUNC_READFLASH) {
+
+		if (!prog_address_newmode)
+			prog_address = rq->wValue.word;
+
+		prog_nbytes = (data[7] << 8) | data[6];
+		prog_state = PROG_STATE_READFLASH;
+		len = ENGINE_STREAM; /* multiple in */
+		// this allows reading after a write
+		flashIdle();
+		// log_print("read flash from 0x%lx", prog_address);
+
+	} else if (rq->bRequest == USBASP_FUNC_READFLASH_RLE) {
+
+		if (!prog_address_newmode)
+			prog_address = rq->wValue.word;
+
+		prog_nbytes = (data[5] << 8) | data[4];
+		rle_budget = (data[7] << 8) | data[6];
+		rle_tokenlen = 0;
+		rle_tokenpos = 0;
+		prog_state = PROG_STATE_READFLASH_RLE;
+		len = ENGINE_STREAM; /* multiple in */
+		flashIdle();
+
+	} else if ((rq->bRequest == USBASP_FUNC_READFLASH_LONG)
+			|| (rq->bRequest == USBASP_FUNC_WRITEFLASH_LONG)) {
+
+		/* wValue zero-extends, data[3] << 8 would be a negative int for
+		 * addresses with bit 15 set */
+		prog_address = ((unsigned long) data[4] << 16) | rq->wValue.word;
+		prog_blockflags = data[5] & 0x0F;
+		prog_nbytes = (data[7] << 8) | data[6];
+		if (rq->bRequest == USBASP_FUNC_READFLASH_LONG) {
+			prog_state = PROG_STATE_READFLASH;
+			flashIdle();
+		} else {
+			prog_state = PROG_STATE_WRITEFLASH;
+			fingerprintInvalidate();
+			flashEraseWait();
+		}
+		len = ENGINE_STREAM; /* multiple in/out */
+
+	} else if (rq->bRequest == USBASP_FUNC_READFLASH_SG) {
+
+		prog_state = PROG_STATE_READFLASH_SG;
+		len = ENGINE_STREAM; /* multiple in */
+		flashIdle();
+
+	} else if (rq->bRequest == USBASP_FUNC_READEEPROM) {
+
+		if (!prog_address_newmode)
+			prog_address = rq->wValue.word;
+
+		prog_nbytes = (data[7] << 8) | data[6];
+		prog_state = PROG_STATE_READEEPROM;
+		len = ENGINE_STREAM; /* multiple in */
+		//log_print("read EEPROM 0x%lx", prog_address);
+
+	} else if (rq->bRequest == USBASP_FUNC_ENABLEPROG) {
+		log_print("enable prog");
+		replyBuffer[0] = 0;//ispEnterProgrammingMode();
+		len = 1;
+
+	} else if (rq->bRequest == USBASP_FUNC_WRITEFLASH) {
+		if (!prog_address_newmode)
+			prog_address = rq->wValue.word;
+
+		/* the page cache takes care of page boundaries, so the page size
+		 * in data[4] and the high nibble of data[5] isn't needed */
+		prog_blockflags = data[5] & 0x0F;
+		prog_nbytes = (data[7] << 8) | data[6];
+		prog_state = PROG_STATE_WRITEFLASH;
+		len = ENGINE_STREAM; /* multiple out */
+		fingerprintInvalidate();
+		flashEraseWait();
+		// log_print("write flash \naddr: 0x%lx\nblockflags: 0x%x\nnbytes: 0x%x", prog_address, prog_blockflags, prog_nbytes);
+
+	} else if (rq->bRequest == USBASP_FUNC_WRITEFLASH_SG) {
+
+		sg_headerpos = 0;
+		sg_remaining = 0;
+		prog_nbytes = (data[7] << 8) | data[6];
+		prog_state = PROG_STATE_WRITEFLASH_SG;
+		len = ENGINE_STREAM; /* multiple out */
+		fingerprintInvalidate();
+		flashEraseWait();
+
+	} else if (rq->bRequest == USBASP_FUNC_SETREADLIST) {
+
+		prog_nbytes = (data[7] << 8) | data[6];
+		if (prog_nbytes <= sizeof(sg_ranges)) {
+			sg_rangecount = prog_nbytes / USBASP_SG_RECORDSIZE;
+			sg_index = 0;
+			prog_state = PROG_STATE_SETREADLIST;
+			len = ENGINE_STREAM; /* multiple out */
+		}
+
+	} else if (rq->bRequest == USBASP_FUNC_WRITEEEPROM) {
+
+		if (!prog_address_newmode)
+			prog_address = rq->wValue.word;
+
+		prog_blockflags = 0;
+		prog_nbytes = (data[7] << 8) | data[6];
+		prog_state = PROG_STATE_WRITEEEPROM;
+		len = ENGINE_STREAM; /* multiple out */
+		// log_print("write eeprom 0x%lx", prog_address);
+
+	} else if (rq->bRequest == USBASP_FUNC_SETLONGADDRESS) {
+
+		/* set new mode of address delivering (ignore address delivered in commands) */
+		prog_address_newmode = 1;
+		/* set new address */
+		prog_address = *((unsigned long*) &data[2]);
+		// log_print("set Long address to 0x%lx", prog_address);
+
+	} else if (rq->bRequest == USBASP_FUNC_SETISPSCK) {
+		log_print("set spi clock");
+
+		/* set sck option */
+		prog_sck = data[2];
+		replyBuffer[0] = 0;
+		len = 1;
+	
+	} else if (rq->bRequest == USBASP_FUNC_GETCAPABILITIES) {
+		// log_print("get capabilities asked");
+		replyBuffer[0] = 1;
+		replyBuffer[1] = USBASP_CAP_1_LONGTRANSFERS;
+		replyBuffer[2] = USBASP_MAX_BLOCKSIZE & 0xff;
+		replyBuffer[3] = USBASP_MAX_BLOCKSIZE >> 8;
+		len = 4;
+
+	} else if (rq->bRequest == USBASP_FUNC_GETGEOMETRY) {
+		usbaspGeometry_t* geometry = (void*)replyBuffer;
+
+		geometry->version = USBASP_PROTOCOL_VERSION;
+		geometry->features = USBASP_FEATURE_RLE | USBASP_FEATURE_SG
+				| USBASP_FEATURE_LONGADDRESS | USBASP_FEATURE_LONGTRANSFER
+				| USBASP_FEATURE_BGERASE | USBASP_FEATURE_ERASEAHEAD
+				| USBASP_FEATURE_PAGECACHE | USBASP_FEATURE_IDENTITY
+				| USBASP_FEATURE_CRC32 | USBASP_FEATURE_FINGERPRINT
+				| USBASP_FEATURE_RESUME;
+#if BOOT_CFG_AB_SLOTS
+		geometry->features |= USBASP_FEATURE_ABSLOTS;
+#endif
+#if BOOT_CFG_SELFUPDATE
+		geometry->features |= USBASP_FEATURE_SELFUPDATE;
+#endif
+		geometry->pagesize = SPM_PAGESIZE;
+		geometry->flashsize = flashWindowSize();
+		geometry->bootstart = FLASH_BOOT_START;
+		geometry->eepromsize = E2END + 1;
+		geometry->maxblock = USBASP_MAX_BLOCKSIZE;
+		geometry->staging = FLASH_CACHE_PAGES * SPM_PAGESIZE;
+		len = sizeof(usbaspGeometry_t);
+
+	} else if (rq->bRequest == USBASP_FUNC_GETIDENTITY) {
+		usbaspIdentity_t* identity = (void*)replyBuffer;
+
+		identity->signature[0] = boot_signature_byte_get(0x00);
+		identity->signature[1] = boot_signature_byte_get(0x02);
+		identity->signature[2] = boot_signature_byte_get(0x04);
+		identity->lfuse = boot_lock_fuse_bits_get(GET_LOW_FUSE_BITS);
+		identity->hfuse = boot_lock_fuse_bits_get(GET_HIGH_FUSE_BITS);
+		identity->efuse = boot_lock_fuse_bits_get(GET_EXTENDED_FUSE_BITS);
+		identity->lock = boot_lock_fuse_bits_get(GET_LOCK_BITS);
+		identity->osccal = boot_signature_byte_get(0x01);
+		for (i = 0; i < USBASP_SERIAL_LEN; i++) {
+			identity->serial[i] = serialBytes[i];
+		}
+		len = sizeof(usbaspIdentity_t);
+
+	} else if (rq->bRequest == USBASP_FUNC_CRC32) {
+		unsigned long start = (unsigned long) rq->wValue.word * SPM_PAGESIZE;
+		unsigned long length = (unsigned long) rq->wIndex.word * SPM_PAGESIZE;
+		uint32_t crc;
+
+		/* the boot section is nothing the host has written */
+		if (start > FLASH_BOOT_START)
+			start = FLASH_BOOT_START;
+		if (length > FLASH_BOOT_START - start)
+			length = FLASH_BOOT_START - start;
+
+		flashIdle();
+		crc = flashCrc32(start, length);
+		replyBuffer[0] = crc;
+		replyBuffer[1] = crc >> 8;
+		replyBuffer[2] = crc >> 16;
+		replyBuffer[3] = crc >> 24;
+		len = 4;
+
+	} else if (rq->bRequest == USBASP_FUNC_GETFINGERPRINT) {
+		eeprom_read_block(replyBuffer, (void*)USBASP_EEPROM_FINGERPRINT, sizeof(usbaspFingerprint_t));
+		len = sizeof(usbaspFingerprint_t);
+
+	} else if (rq->bRequest == USBASP_FUNC_SETFINGERPRINT) {
+		/* this also refuses USBASP_FINGERPRINT_NONE */
+		if (rq->wValue.word <= FLASH_BOOT_START / SPM_PAGESIZE) {
+			fingerprint_pages = rq->wValue.word;
+			prog_nbytes = 0;
+			prog_state = PROG_STATE_SETFINGERPRINT;
+			len = ENGINE_STREAM; /* multiple out */
+		}
+
+	} else if (rq->bRequest == USBASP_FUNC_SETSESSION) {
+		session_datapos = 0;
+		prog_state = PROG_STATE_SETSESSION;
+		len = ENGINE_STREAM; /* multiple out */
+
+	} else if (rq->bRequest == USBASP_FUNC_GETRESUME) {
+		uint16_t page = journalResumePage();
+
+		replyBuffer[0] = page;
+		replyBuffer[1] = page >> 8;
+		len = 2;
+
+#if BOOT_CFG_AB_SLOTS
+	} else if (rq->bRequest == USBASP_FUNC_GETSLOTS) {
+		slotsGet((void*)replyBuffer);
+		len = sizeof(usbaspSlots_t);
+
+	} else if (rq->bRequest == USBASP_FUNC_ACTIVATESLOT) {
+		slot_pages = rq->wValue.word;
+		slot_crcpos = 0;
+		prog_state = PROG_STATE_ACTIVATESLOT;
+		len = ENGINE_STREAM; /* multiple out */
+#endif
+
+#if BOOT_CFG_SELFUPDATE
+	} else if (rq->bRequest == USBASP_FUNC_SELFUPDATE) {
+		selfupdate_pages = rq->wValue.word;
+		selfupdate_crcpos = 0;
+		prog_state = PROG_STATE_SELFUPDATE;
+		len = ENGINE_STREAM; /* multiple out */
+#endif
+	}
+
+	*reply = replyBuffer;
+
+	return len;
+}
+
+uchar engineRead(uchar* data, uchar len) {
+
+	uchar i;
+
+	if (prog_state == PROG_STATE_READFLASH_RLE) {
+		for (i = 0; i < len; i++) {
+			if (rle_tokenpos == rle_tokenlen) {
+				if ((prog_nbytes == 0) || !rleNextToken())
+					break;
+			}
+			data[i] = rle_token[rle_tokenpos++];
+		}
+
+		/* short packet ends the transfer */
+		if (i < len) {
+			prog_state = PROG_STATE_IDLE;
+		}
+
+		return i;
+	}
+
+	if (prog_state == PROG_STATE_READFLASH_SG) {
+		for (i = 0; i < len; i++) {
+			while (sg_readremaining == 0) {
+				if (sg_index == sg_rangecount)
+					break;
+				sgLoadRecord(&sg_ranges[sg_index * USBASP_SG_RECORDSIZE],
+						&sg_readaddress, &sg_readremaining);
+				sg_index++;
+			}
+			if (sg_readremaining == 0)
+				break;
+			data[i] = flashReadByte(sg_readaddress++);
+			sg_readremaining--;
+		}
+
+		/* the list is done, the next request starts it over */
+		if (i < len) {
+			sg_index = 0;
+			prog_state = PROG_STATE_IDLE;
+		}
+
+		return i;
+	}
+
+	/* check if programmer is in correct read state */
+	if ((prog_state != PROG_STATE_READFLASH) && (prog_state
+			!= PROG_STATE_READEEPROM)) {
+		return 0xff;
+	}
+
+	/* fill packet ISP mode */
+	for (i = 0; (i < len) && (prog_nbytes != 0); i++) {
+		if (prog_state == PROG_STATE_READFLASH) {
+			data[i] = flashReadByte(prog_address);
+		} else {
+			data[i] = eeprom_read_byte(prog_address);
+		}
+		prog_address++;
+		prog_nbytes--;
+	}
+
+	/* last packet? the front end may read in pieces of any size, so the
+	 * requested length ends the transfer rather than a short packet */
+	if (prog_nbytes == 0) {
+		prog_state = PROG_STATE_IDLE;
+	}
+
+	return i;
+}
+
+uchar engineFeed(uchar* data, uchar len) {
+
+	uchar retVal = 0;
+	uchar i;
+
+	/* check if programmer is in correct write state */
+	if ((prog_state != PROG_STATE_WRITEFLASH) && (prog_state
+			!= PROG_STATE_WRITEEEPROM) && (prog_state != PROG_STATE_TPI_WRITE)
+			&& (prog_state != PROG_STATE_WRITEFLASH_SG) && (prog_state != PROG_STATE_SETREADLIST)
+			&& (prog_state != PROG_STATE_SETFINGERPRINT) && (prog_state != PROG_STATE_ACTIVATESLOT)
+			&& (prog_state != PROG_STATE_SETSESSION) && (prog_state != PROG_STATE_SELFUPDATE)) {
+		return 0xff;
+	}
+
+	/* never read past the end of the transfer */
+	if (((prog_state == PROG_STATE_WRITEFLASH_SG) || (prog_state == PROG_STATE_SETREADLIST))
+			&& (len > prog_nbytes)) {
+		len = prog_nbytes;
+	}
+
+	if (prog_state == PROG_STATE_WRITEFLASH_SG) {
+		for (i = 0; i < len; i++) {
+			if (sg_remaining == 0) {
+				/* record header */
+				sg_header[sg_headerpos++] = data[i];
+				if (sg_headerpos == USBASP_SG_RECORDSIZE) {
+					sgLoadRecord(sg_header, &prog_address, &sg_remaining);
+					sg_headerpos = 0;
+				}
+			} else {
+				flashCacheWrite(prog_address++, data[i]);
+				sg_remaining--;
+			}
+		}
+		prog_nbytes -= len;
+		if (prog_nbytes == 0) {
+			prog_state = PROG_STATE_IDLE;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (prog_state == PROG_STATE_SETFINGERPRINT) {
+		for (i = 0; i < len; i++) {
+			if (prog_nbytes < USBASP_BUILDID_LEN)
+				fingerprint_buildid[prog_nbytes++] = data[i];
+		}
+		if (prog_nbytes == USBASP_BUILDID_LEN) {
+			fingerprintStore();
+			prog_state = PROG_STATE_IDLE;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (prog_state == PROG_STATE_SETSESSION) {
+		for (i = 0; i < len; i++) {
+			if (session_datapos < sizeof(session_data))
+				session_data[session_datapos++] = data[i];
+		}
+		if (session_datapos == sizeof(session_data)) {
+			journalBegin(*((uint32_t*) &session_data[0]), *((uint32_t*) &session_data[4]));
+			prog_state = PROG_STATE_IDLE;
+			return 1;
+		}
+		return 0;
+	}
+
+#if BOOT_CFG_AB_SLOTS
+	if (prog_state == PROG_STATE_ACTIVATESLOT) {
+		for (i = 0; i < len; i++) {
+			if (slot_crcpos < sizeof(slot_crc))
+				slot_crc[slot_crcpos++] = data[i];
+		}
+		if (slot_crcpos == sizeof(slot_crc)) {
+			if (!slotsActivate(slot_pages, *((uint32_t*) slot_crc))) {
+				log_print("slot failed verification, keeping the active one");
+			}
+			prog_state = PROG_STATE_IDLE;
+			return 1;
+		}
+		return 0;
+	}
+#endif
+
+#if BOOT_CFG_SELFUPDATE
+	if (prog_state == PROG_STATE_SELFUPDATE) {
+		for (i = 0; i < len; i++) {
+			if (selfupdate_crcpos < sizeof(selfupdate_crc))
+				selfupdate_crc[selfupdate_crcpos++] = data[i];
+		}
+		if (selfupdate_crcpos == sizeof(selfupdate_crc)) {
+			prog_state = PROG_STATE_IDLE;
+			if (!selfUpdateArm(selfupdate_pages, *((uint32_t*) selfupdate_crc))) {
+				log_print("bootloader image failed verification");
+				return 0xff;
+			}
+			/* main() runs the copier once the host is gone */
+			engine_finished = 1;
+			return 1;
+		}
+		return 0;
+	}
+#endif
+
+	if (prog_state == PROG_STATE_SETREADLIST) {
+		for (i = 0; i < len; i++) {
+			sg_ranges[sg_index++] = data[i];
+		}
+		prog_nbytes -= len;
+		if (prog_nbytes == 0) {
+			sg_index = 0;
+			sg_readremaining = 0;
+			prog_state = PROG_STATE_IDLE;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (prog_state == PROG_STATE_TPI_WRITE)
+	{
+		// tpi_write_block(prog_address, data, len);
+		prog_address += len;
+		prog_nbytes -= len;
+		if(prog_nbytes <= 0)
+		{
+			prog_state = PROG_STATE_IDLE;
+			return 1;
+		}
+		return 0;
+	}
+
+	for (i = 0; i < len; i++) {
+
+		if (prog_state == PROG_STATE_WRITEFLASH) {
+			/* Flash */
+
+			flashCacheWrite(prog_address, data[i]);
+
+			/* more pages follow, erase the next one while it is received */
+			if (((prog_address & (SPM_PAGESIZE - 1)) == (SPM_PAGESIZE - 1))
+					&& ((prog_nbytes > 1) || (prog_blockflags & PROG_BLOCKFLAG_SEQUENTIAL))) {
+				flashEraseAhead(prog_address + 1);
+			}
+
+		} else {
+			/* EEPROM, not while an erase ahead or page write is running */
+			boot_spm_busy_wait();
+			eeprom_write_byte(prog_address, data[i]);
+		}
+
+		prog_address++;
+		prog_nbytes--;
+
+		if (prog_nbytes == 0) {
+			if (prog_state == PROG_STATE_WRITEFLASH)
+				journalProgress(prog_address);
+			prog_state = PROG_STATE_IDLE;
+			retVal = 1; // Need to return 1 when no more data is to be received
+			break;
+		}
+	}
+	// log_print("eow: prgad: 0x%05x", prog_address);
+
+	return retVal;
+}
+
+void engineInit(void) {
+	uchar i;
+
+	if (eeprom_read_byte((uint8_t*)USBASP_EEPROM_SERIAL) != 0xff) {
+		eeprom_read_block(serialBytes, (void*)USBASP_EEPROM_SERIAL, USBASP_SERIAL_LEN);
+	} else {
+		for (i = 0; i < USBASP_SERIAL_LEN; i++) {
+			serialBytes[i] = boot_signature_byte_get(USBASP_SERIAL_OFFSET + i);
+		}
+	}
+}
+
+const uchar* engineSerial(void) {
+	return serialBytes;
+}
+
+uchar engineStatus(void) {
+	uchar status = 0;
+
+	if (prog_state != PROG_STATE_IDLE)
+		status |= ENGINE_STATUS_BUSY;
+	if (flashEraseBusy())
+		status |= ENGINE_STATUS_ERASING;
+	if (engine_finished)
+		status |= ENGINE_STATUS_FINISHED;
+	return status;
+}
+
+void engineTask(void) {
+	flashEraseTask();
+}
+
+void engineEnd(void) {
+	flashIdle();
+}
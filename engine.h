@@ -0,0 +1,58 @@
+/*
+ * engine.h - part of USBasp bootloader
+ *
+ * Description....: Transport independent programming engine
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __engine_h_included__
+#define __engine_h_included__
+
+#include <inttypes.h>
+
+/* The engine runs the requests of usbasp.h for any transport. A request is
+ * begun with the 8 byte USB setup packet layout, then its data stage is
+ * either fed to or read from the engine in pieces of any size up to 255.
+ * The front ends are the V-USB callbacks in main.c, the framed UART link in
+ * uartlink.c and the HID reports in hid.c.
+ *
+ * Only the transport is abstracted. The engine still reads signature, fuses
+ * and EEPROM directly and drives flash.c, journal.c, slots.c and
+ * selfupdate.c, so it is tied to this bootloader and the AVR it runs on. */
+
+/* engineSetup() return value, the data stage goes through engineRead() or
+ * engineFeed() instead of a reply */
+#define ENGINE_STREAM           0xffff
+
+/* engineStatus() bits */
+#define ENGINE_STATUS_BUSY      0x01    /* a data stage is in progress */
+#define ENGINE_STATUS_ERASING   0x02    /* chip erase still running */
+#define ENGINE_STATUS_FINISHED  0x04    /* the host has disconnected */
+
+void engineInit(void);
+
+/* begin a request, returns the reply length with *reply pointing to it, or
+ * ENGINE_STREAM */
+uint16_t engineSetup(uint8_t* data, uint8_t** reply);
+
+/* data stage of a write request, returns 0 while more is expected, 1 at the
+ * end and 0xff on error */
+uint8_t engineFeed(uint8_t* data, uint8_t len);
+
+/* data stage of a read request, returns the number of bytes stored, less
+ * than len at the end */
+uint8_t engineRead(uint8_t* data, uint8_t len);
+
+uint8_t engineStatus(void);
+
+/* background work, call this from the main loop */
+void engineTask(void);
+
+/* finish everything the engine has buffered before leaving */
+void engineEnd(void);
+
+const uint8_t* engineSerial(void);
+
+#endif /* __engine_h_included__ */
@@ -0,0 +1,50 @@
+/*
+ * servicedemo.c - part of USBasp bootloader
+ *
+ * Description....: Example application using the bootloader services. Keeps
+ *                  a boot counter in the last application page and stores
+ *                  the CRC-32 of the application in EEPROM.
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+
+#include "services.h"
+
+/* last page below the boot section */
+#define LOG_PAGE    (0x1E000UL - SPM_PAGESIZE)
+
+static uint8_t page[SPM_PAGESIZE];
+
+int main(void) {
+	uint32_t count, crc;
+	uint16_t i;
+
+	if (bootServiceVersion() < 1)
+		for (;;);
+
+	for (i = 0; i < SPM_PAGESIZE; i++) {
+		page[i] = pgm_read_byte_far(LOG_PAGE + i);
+	}
+
+	memcpy(&count, page, sizeof(count));
+	count = (count == 0xffffffff) ? 1 : count + 1;
+	memcpy(page, &count, sizeof(count));
+	bootServicePageProgram(LOG_PAGE, page);
+
+	crc = bootServiceCrc32(0, LOG_PAGE);
+	bootServiceEepromUpdate(0, &crc, sizeof(crc));
+
+	/* LED on every other start */
+	DDRB |= _BV(PB7);
+	if (count & 1)
+		PORTB |= _BV(PB7);
+
+	for (;;);
+
+	return 0;
+}
@@ -0,0 +1,326 @@
+/*
+ * flash.c - part of USBasp bootloader
+ *
+ * Description....: Self-programming helpers for the application section
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/boot.h>
+#include <string.h>
+
+#include "flash.h"
+
+/* page cache flags */
+#define CACHE_USED      0x01
+#define CACHE_MERGED    0x02    /* unwritten bytes hold the current flash content */
+#define CACHE_ERASED    0x04    /* flash page already erased, RAM holds the only copy */
+
+typedef struct {
+	unsigned long address;
+	uint8_t flags;
+	uint16_t written;           /* number of distinct bytes written by the host */
+	uint8_t mask[SPM_PAGESIZE / 8];
+	uint8_t data[SPM_PAGESIZE];
+} flashCachePage_t;
+
+static flashCachePage_t cache[FLASH_CACHE_PAGES];
+static flashCachePage_t* cache_last = 0;
+static uint8_t cache_victim = 0;
+
+/* CRC-32 (IEEE 802.3, reflected) one nibble at a time, a full table wouldn't
+ * fit the boot section. Kept in flash, the service table calls this without
+ * the bootloader's .data */
+static const uint32_t crc32_nibble[16] PROGMEM = {
+	0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+	0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+	0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+	0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static unsigned long window_start = 0;
+static unsigned long window_end = FLASH_BOOT_START;
+
+static unsigned long erase_address;
+static uint8_t erase_active = 0;
+
+static unsigned long ahead_address;
+static uint8_t ahead_pending = 0;
+
+/* spm has to follow the SPMCSR write within 4 cycles, so keep the USB
+ * interrupt out of the way for just that instruction pair */
+#define FLASH_SPM(op) do { uint8_t sreg = SREG; cli(); op; SREG = sreg; } while (0)
+
+static void flashPageErase(unsigned long address) {
+	boot_spm_busy_wait();
+	eeprom_busy_wait();
+	FLASH_SPM(boot_page_erase(address));
+}
+
+/* fill the temporary page buffer and start the write, the write completes in
+ * the background and the next spm waits for it */
+static void flashPageFillWrite(unsigned long address, const uint8_t* data) {
+	uint16_t i;
+
+	boot_spm_busy_wait();
+	eeprom_busy_wait();
+	for (i = 0; i < SPM_PAGESIZE; i += 2) {
+		FLASH_SPM(boot_page_fill(address + i, data[i] | (data[i + 1] << 8)));
+	}
+	FLASH_SPM(boot_page_write(address));
+}
+
+static void flashRwwEnable(void) {
+	boot_spm_busy_wait();
+	if (boot_rww_busy())
+		boot_rww_enable_safe();
+}
+
+uint8_t flashReadByte(unsigned long address) {
+	return (address > UINT16_MAX) ? pgm_read_byte_far(address) : pgm_read_byte_near(address);
+}
+
+uint8_t flashPageBlank(unsigned long address) {
+	uint16_t i;
+
+	for (i = 0; i < SPM_PAGESIZE; i++) {
+		if (flashReadByte(address + i) != 0xff)
+			return 0;
+	}
+	return 1;
+}
+
+#define CRC32_NIBBLE(i) pgm_read_dword_far(pgm_get_far_address(crc32_nibble) + 4 * (i))
+
+uint32_t flashCrc32(unsigned long address, unsigned long length) {
+	uint32_t crc = 0xffffffff;
+
+	while (length--) {
+		crc ^= flashReadByte(address++);
+		crc = (crc >> 4) ^ CRC32_NIBBLE(crc & 0x0f);
+		crc = (crc >> 4) ^ CRC32_NIBBLE(crc & 0x0f);
+	}
+	return ~crc;
+}
+
+void flashPageWrite(unsigned long address, const uint8_t* data) {
+	flashPageErase(address);
+	flashPageFillWrite(address, data);
+}
+
+/* fill the bytes the host hasn't written with the current flash content */
+static void flashCacheMerge(flashCachePage_t* p) {
+	uint16_t i;
+
+	if ((p->flags & CACHE_MERGED) || (p->written == SPM_PAGESIZE))
+		return;
+
+	flashRwwEnable();
+	for (i = 0; i < SPM_PAGESIZE; i++) {
+		if (!(p->mask[i >> 3] & _BV(i & 7)))
+			p->data[i] = flashReadByte(p->address + i);
+	}
+	p->flags |= CACHE_MERGED;
+}
+
+static void flashCacheProgram(flashCachePage_t* p) {
+	uint16_t i;
+
+	if (!(p->flags & CACHE_ERASED)) {
+		flashCacheMerge(p);
+		flashRwwEnable();
+
+		/* nothing changed, save the erase/write cycle */
+		for (i = 0; i < SPM_PAGESIZE; i++) {
+			if (flashReadByte(p->address + i) != p->data[i])
+				break;
+		}
+		if (i == SPM_PAGESIZE) {
+			p->flags = 0;
+			return;
+		}
+
+		flashPageErase(p->address);
+	}
+
+	/* an erased page already reads all 0xff, skip writing blank pages */
+	for (i = 0; i < SPM_PAGESIZE; i++) {
+		if (p->data[i] != 0xff)
+			break;
+	}
+	if (i != SPM_PAGESIZE)
+		flashPageFillWrite(p->address, p->data);
+	p->flags = 0;
+}
+
+static flashCachePage_t* flashCacheFind(unsigned long page) {
+	uint8_t i;
+
+	if (cache_last && (cache_last->flags & CACHE_USED) && (cache_last->address == page))
+		return cache_last;
+
+	for (i = 0; i < FLASH_CACHE_PAGES; i++) {
+		if ((cache[i].flags & CACHE_USED) && (cache[i].address == page))
+			return cache_last = &cache[i];
+	}
+	return 0;
+}
+
+/* returns 0 if every slot is in use and evict isn't set */
+static flashCachePage_t* flashCacheAlloc(unsigned long page, uint8_t evict) {
+	flashCachePage_t* p = 0;
+	uint8_t i;
+
+	for (i = 0; i < FLASH_CACHE_PAGES; i++) {
+		if (!(cache[i].flags & CACHE_USED)) {
+			p = &cache[i];
+			break;
+		}
+	}
+
+	if (!p) {
+		if (!evict)
+			return 0;
+		p = &cache[cache_victim];
+		cache_victim = (cache_victim + 1) % FLASH_CACHE_PAGES;
+		flashCacheProgram(p);
+	}
+
+	p->address = page;
+	p->flags = CACHE_USED;
+	p->written = 0;
+	memset(p->mask, 0, sizeof(p->mask));
+	return cache_last = p;
+}
+
+void flashCacheWrite(unsigned long address, uint8_t value) {
+	unsigned long page = address & ~((unsigned long) SPM_PAGESIZE - 1);
+	uint16_t offset = address & (SPM_PAGESIZE - 1);
+	flashCachePage_t* p;
+
+	/* never touch the bootloader itself or anything outside the window */
+	if ((address < window_start) || (address >= window_end))
+		return;
+
+	p = flashCacheFind(page);
+	if (!p)
+		p = flashCacheAlloc(page, 1);
+
+	p->data[offset] = value;
+	if (!(p->mask[offset >> 3] & _BV(offset & 7))) {
+		p->mask[offset >> 3] |= _BV(offset & 7);
+		p->written++;
+	}
+
+	/* nothing left to merge, no reason to keep it */
+	if (p->written == SPM_PAGESIZE)
+		flashCacheProgram(p);
+}
+
+void flashEraseStart(void) {
+	uint8_t i;
+
+	/* whatever was cached predates the erase */
+	for (i = 0; i < FLASH_CACHE_PAGES; i++) {
+		cache[i].flags = 0;
+	}
+	ahead_pending = 0;
+
+	erase_address = window_start;
+	erase_active = 1;
+}
+
+void flashEraseTask(void) {
+	flashCachePage_t* p;
+
+	if (boot_spm_busy())
+		return;
+
+	/* the application section can't be read until it is re-enabled after
+	 * the last erase or write */
+	if ((ahead_pending || erase_active) && boot_rww_busy()) {
+		boot_rww_enable_safe();
+		return;
+	}
+
+	if (ahead_pending) {
+		ahead_pending = 0;
+		p = flashCacheFind(ahead_address);
+		if (!p)
+			p = flashCacheAlloc(ahead_address, 0);
+		if (p && !(p->flags & CACHE_ERASED)) {
+			flashCacheMerge(p);
+			flashPageErase(ahead_address);
+			p->flags |= CACHE_ERASED;
+		}
+		return;
+	}
+
+	if (!erase_active)
+		return;
+
+	if (erase_address >= window_end) {
+		erase_active = 0;
+		return;
+	}
+
+	if (!flashPageBlank(erase_address)) {
+		flashPageErase(erase_address);
+	}
+	erase_address += SPM_PAGESIZE;
+}
+
+uint8_t flashEraseBusy(void) {
+	return erase_active;
+}
+
+void flashEraseWait(void) {
+	while (erase_active) {
+		flashEraseTask();
+	}
+}
+
+void flashIdle(void) {
+	uint8_t i;
+
+	ahead_pending = 0;
+	flashEraseWait();
+
+	for (i = 0; i < FLASH_CACHE_PAGES; i++) {
+		if (cache[i].flags & CACHE_USED)
+			flashCacheProgram(&cache[i]);
+	}
+
+	flashRwwEnable();
+}
+
+void flashFlush(unsigned long end) {
+	uint8_t i;
+
+	flashEraseWait();
+
+	for (i = 0; i < FLASH_CACHE_PAGES; i++) {
+		if ((cache[i].flags & CACHE_USED) && (cache[i].address < end))
+			flashCacheProgram(&cache[i]);
+	}
+}
+
+void flashSetWindow(unsigned long start, unsigned long end) {
+	window_start = start;
+	window_end = end;
+}
+
+unsigned long flashWindowSize(void) {
+	return window_end - window_start;
+}
+
+void flashEraseAhead(unsigned long address) {
+	if ((address < window_start) || (address >= window_end))
+		return;
+	ahead_address = address;
+	ahead_pending = 1;
+}
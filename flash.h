@@ -0,0 +1,72 @@
+/*
+ * flash.h - part of USBasp bootloader
+ *
+ * Description....: Self-programming helpers for the application section
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __flash_h_included__
+#define __flash_h_included__
+
+#include <inttypes.h>
+
+/* first byte of the boot section, the application area ends here */
+#define FLASH_BOOT_START    0x1E000UL
+
+/* number of pages held in the RAM write cache */
+#define FLASH_CACHE_PAGES   4
+
+uint8_t flashReadByte(unsigned long address);
+
+/* returns 1 if every byte of the page at address reads 0xff */
+uint8_t flashPageBlank(unsigned long address);
+
+/* standard CRC-32 (as zlib's crc32()) over a range of flash, the range must
+ * be readable, see flashIdle() */
+uint32_t flashCrc32(unsigned long address, unsigned long length);
+
+/* start a background erase of the application area (or the window set with
+ * flashSetWindow()), pages already blank are skipped. flashEraseTask() must
+ * be called from the main loop to advance it, one page per call, while the
+ * cpu keeps running from the boot section */
+void flashEraseStart(void);
+void flashEraseTask(void);
+uint8_t flashEraseBusy(void);
+
+/* block until a pending background erase has finished */
+void flashEraseWait(void);
+
+/* write all cached pages, finish all background flash work and re-enable the
+ * application section for reading, an erase-ahead that hasn't started yet is
+ * dropped */
+void flashIdle(void);
+
+/* write the cached pages below end to flash, unlike flashIdle() this keeps
+ * an erase-ahead of the page at end, pending or done, and leaves the
+ * application section as it is */
+void flashFlush(unsigned long end);
+
+/* write a single byte through the page cache. Partial pages are merged with
+ * the current flash content when they are written out, which happens once
+ * every byte of the page has been written, on eviction or in flashIdle() */
+void flashCacheWrite(unsigned long address, uint8_t value);
+
+/* limit cached writes and chip erase to [start, end), the whole application
+ * area by default */
+void flashSetWindow(unsigned long start, unsigned long end);
+
+/* number of bytes in the window */
+unsigned long flashWindowSize(void);
+
+/* erase the page at address in the background once the spm unit is free,
+ * used to erase the next page of a sequential upload while it is still
+ * being received */
+void flashEraseAhead(unsigned long address);
+
+/* erase and program a whole page from RAM, bypassing the cache. The write
+ * itself completes in the background */
+void flashPageWrite(unsigned long address, const uint8_t* data);
+
+#endif /* __flash_h_included__ */
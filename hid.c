@@ -0,0 +1,135 @@
+/*
+ * hid.c - part of USBasp bootloader
+ *
+ * Description....: HID feature report front end of the engine
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <string.h>
+
+#include "hid.h"
+
+#if BOOT_CFG_HID
+
+#include "usbasp.h"
+#include "engine.h"
+
+#define HID_REPORT_TYPE_FEATURE 3
+
+static uchar hid_report = 0;            /* report of the running transfer */
+static unsigned int hid_pos;            /* position in it, 0 is the report ID */
+static uchar hid_command[USBASP_HID_COMMANDLEN];
+static uchar hid_reply[USBASP_HID_COMMANDLEN];
+static uchar hid_address[4];           /* and the block flags, as wValue/wIndex */
+static uchar hid_result;
+
+static void hidCommand(void) {
+	usbRequest_t* rq = (void*)hid_command;
+	uchar* reply;
+	uint16_t len;
+
+	memset(hid_reply, 0, sizeof(hid_reply));
+	len = engineSetup(hid_command, &reply);
+
+	if (len != ENGINE_STREAM) {
+		memcpy(hid_reply, reply, (len < sizeof(hid_reply)) ? len : sizeof(hid_reply));
+	} else if (!(rq->bmRequestType & USBRQ_DIR_DEVICE_TO_HOST) && rq->wLength.word) {
+		/* short data stages travel along with the command */
+		len = rq->wLength.word;
+		if (len > USBASP_HID_COMMANDLEN - 8)
+			len = USBASP_HID_COMMANDLEN - 8;
+		hid_reply[0] = engineFeed(&hid_command[8], len);
+	}
+}
+
+static void hidBeginPage(void) {
+	uchar setup[8] = {
+		USBRQ_TYPE_VENDOR, USBASP_FUNC_WRITEFLASH_LONG,
+		hid_address[0], hid_address[1], hid_address[2], hid_address[3],
+		USBASP_HID_PAGELEN & 0xff, USBASP_HID_PAGELEN >> 8
+	};
+	uchar* reply;
+
+	engineSetup(setup, &reply);
+	hid_result = 0;
+}
+
+usbMsgLen_t hidSetup(usbRequest_t* rq) {
+	if (rq->wValue.bytes[1] != HID_REPORT_TYPE_FEATURE)
+		return 0;
+
+	if ((rq->bRequest == USBRQ_HID_SET_REPORT) || (rq->bRequest == USBRQ_HID_GET_REPORT)) {
+		hid_report = rq->wValue.bytes[0];
+		hid_pos = 0;
+		return USB_NO_MSG;
+	}
+	return 0;
+}
+
+uchar hidWrite(uchar* data, uchar len) {
+	uchar i;
+
+	for (i = 0; i < len; i++, hid_pos++) {
+		if (hid_pos == 0)
+			continue;
+
+		if (hid_report == USBASP_HID_REPORT_COMMAND) {
+			hid_command[hid_pos - 1] = data[i];
+			if (hid_pos == USBASP_HID_COMMANDLEN) {
+				hidCommand();
+				return 1;
+			}
+
+		} else if (hid_report == USBASP_HID_REPORT_WRITEPAGE) {
+			if (hid_pos <= sizeof(hid_address)) {
+				hid_address[hid_pos - 1] = data[i];
+				if (hid_pos == sizeof(hid_address))
+					hidBeginPage();
+				continue;
+			}
+
+			/* the rest of the packet is page data */
+			if (hid_result == 0)
+				hid_result = engineFeed(&data[i], len - i);
+			hid_pos += len - i;
+			if (hid_pos > sizeof(hid_address) + USBASP_HID_PAGELEN)
+				return (hid_result == 0xff) ? 0xff : 1;
+			return 0;
+
+		} else {
+			return 0xff;
+		}
+	}
+	return 0;
+}
+
+uchar hidRead(uchar* data, uchar len) {
+	uchar i = 0, got;
+
+	if (hid_pos == 0) {
+		data[i++] = hid_report;
+		hid_pos++;
+	}
+
+	if (hid_report == USBASP_HID_REPORT_COMMAND) {
+		for (; i < len; i++, hid_pos++) {
+			data[i] = (hid_pos <= USBASP_HID_COMMANDLEN) ? hid_reply[hid_pos - 1] : 0;
+		}
+
+	} else if (hid_report == USBASP_HID_REPORT_READPAGE) {
+		got = engineRead(&data[i], len - i);
+		if (got > len - i)
+			got = 0;
+		memset(&data[i + got], 0xff, len - i - got);
+		hid_pos += len - i;
+
+	} else {
+		return 0;
+	}
+	return len;
+}
+
+#endif /* BOOT_CFG_HID */
@@ -0,0 +1,31 @@
+/*
+ * hid.h - part of USBasp bootloader
+ *
+ * Description....: HID feature report front end of the engine
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __hid_h_included__
+#define __hid_h_included__
+
+#include "bootconfig.h"
+
+#if BOOT_CFG_HID
+
+#include "usbdrv.h"
+
+/* The feature reports of usbasp.h are translated to engine requests, a
+ * flash page takes one SET_REPORT instead of a setup and data stage per
+ * block. Called from the V-USB callbacks for class requests. */
+
+usbMsgLen_t hidSetup(usbRequest_t* rq);
+
+uchar hidWrite(uchar* data, uchar len);
+
+uchar hidRead(uchar* data, uchar len);
+
+#endif /* BOOT_CFG_HID */
+
+#endif /* __hid_h_included__ */
@@ -0,0 +1,259 @@
+/*
+ * bench.c - part of USBasp bootloader host tools
+ *
+ * Description....: Upload throughput and correctness benchmark
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "usbasphost.h"
+
+/* most blocks written by each method of the upper 64 KB comparison */
+#define LONGADDRESS_BLOCKS  8
+
+static usbaspImage_t image;
+
+/* the device to run on */
+static const char* serial = 0;
+static const char* tty = 0;
+static uint8_t usb = 0;
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: usbasp-bench [-u | -t tty] [-s serial] [-d depth,...] [-b block,...] [-g bytes | image]\n"
+		"  -u        use an attached bootloader instead of a simulated one\n"
+		"  -t        use a bootloader on that serial line (BOOT_CFG_UART)\n"
+		"  -s        serial number of the device to use with -u\n"
+		"  -d        queue depths to compare, default 1,2,4\n"
+		"  -b        bytes per write request to compare, default 256,4096\n"
+		"  -g        generate a pseudo random image of that size\n");
+	exit(2);
+}
+
+/* deterministic test content with a few blank pages in between, far enough
+ * apart for the largest blocks compared, as much of it as fits the device's
+ * writable window */
+static void generate(const usbaspTransport_t* t, unsigned long size) {
+	unsigned long i;
+	uint32_t x = 12345;
+
+	if (size > t->flashend - t->flashstart)
+		size = t->flashend - t->flashstart;
+	memset(image.data, 0xff, sizeof(image.data));
+	memset(image.used, 0, sizeof(image.used));
+	for (i = t->flashstart; i < t->flashstart + size; i++) {
+		if ((i / USBASP_HOST_PAGESIZE) % 32 == 21)
+			continue;
+		x = x * 1103515245 + 12345;
+		image.data[i] = x >> 16;
+		image.used[i / USBASP_HOST_PAGESIZE] = 1;
+	}
+	image.size = t->flashstart + size;
+	image.ready = USBASP_HOST_FLASHSIZE;
+	image.done = 1;
+	image.status = USBASP_HOST_OK;
+	pthread_mutex_init(&image.lock, 0);
+	pthread_cond_init(&image.changed, 0);
+}
+
+static int compare(const uint8_t* data) {
+	unsigned long i;
+
+	for (i = 0; i < image.size; i++) {
+		if (data[i] != image.data[i]) {
+			fprintf(stderr, "mismatch at 0x%05lx: %02x, expected %02x\n",
+					i, data[i], image.data[i]);
+			return USBASP_HOST_EVERIFY;
+		}
+	}
+	return USBASP_HOST_OK;
+}
+
+/* read everything back, the CRC check can't tell which byte is wrong */
+static int readback(usbaspTransport_t* t, uint64_t* elapsed) {
+	static uint8_t buffer[USBASP_HOST_FLASHSIZE];
+	uint64_t start = t->clock(t);
+	unsigned long address;
+	uint16_t n;
+	int r;
+
+	for (address = 0; address < image.size; address += n) {
+		n = (image.size - address > 2048) ? 2048 : image.size - address;
+		r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, address, address >> 16,
+				&buffer[address], n, 1);
+		if (r != n)
+			return (r < 0) ? r : USBASP_HOST_EIO;
+	}
+	*elapsed = t->clock(t) - start;
+	return compare(buffer);
+}
+
+/* the same through READFLASH_RLE, blank pages shrink to a few triples */
+static int readbackRle(usbaspTransport_t* t, uint64_t* elapsed) {
+	static uint8_t buffer[USBASP_HOST_FLASHSIZE];
+	uint64_t start = t->clock(t);
+	int r;
+
+	r = usbaspReadRle(t, 0, buffer, image.size, 2048);
+	if (r < 0)
+		return r;
+	*elapsed = t->clock(t) - start;
+	return compare(buffer);
+}
+
+/* The same blocks in the upper 64 KB, once the way avrdude writes them with
+ * a SETLONGADDRESS before every WRITEFLASH and once with WRITEFLASH_LONG,
+ * one at a time so each block's latency shows */
+static int longAddress(usbaspTransport_t* t, uint16_t block) {
+	static uint8_t data[USBASP_MAX_BLOCKSIZE];
+	unsigned long address = 0x10000;
+	uint64_t start, pair, single;
+	int i, n, r = 0;
+
+	/* both halves have to fit the writable window */
+	n = (t->flashend > address) ? (t->flashend - address) / 2 / block : 0;
+	if (n > LONGADDRESS_BLOCKS)
+		n = LONGADDRESS_BLOCKS;
+	if (!n)
+		return USBASP_HOST_ERANGE;
+
+	for (i = 0; i < block; i++) {
+		data[i] = i * 13;
+	}
+
+	start = t->clock(t);
+	for (i = 0; (i < n) && (r >= 0); i++, address += block) {
+		r = usbaspControl(t, USBASP_FUNC_SETLONGADDRESS, address, address >> 16, 0, 0, 1);
+		if (r >= 0)
+			r = usbaspControl(t, USBASP_FUNC_WRITEFLASH, address, 0, data, block, 0);
+	}
+	pair = t->clock(t) - start;
+
+	start = t->clock(t);
+	for (i = 0; (i < n) && (r >= 0); i++, address += block) {
+		r = usbaspControl(t, USBASP_FUNC_WRITEFLASH_LONG, address, address >> 16, data, block, 0);
+	}
+	single = t->clock(t) - start;
+	if (r < 0)
+		return r;
+
+	printf("%u byte blocks at 0x10000: SETLONGADDRESS + WRITEFLASH %.2f ms, "
+			"WRITEFLASH_LONG %.2f ms per block\n", block,
+			pair / 1e6 / n, single / 1e6 / n);
+	return USBASP_HOST_OK;
+}
+
+static int benchOpen(usbaspTransport_t** t) {
+	if (tty)
+		return usbaspOpenUart(t, tty);
+	return usb ? usbaspOpenUsb(t, serial) : usbaspOpenSim(t, 0x42);
+}
+
+/* next number of a comma separated list, 0 at its end */
+static unsigned long listNext(const char** list) {
+	unsigned long n;
+
+	if (!**list)
+		return 0;
+	n = strtoul(*list, (char**)list, 0);
+	if (**list == ',')
+		(*list)++;
+	else if (**list)
+		usage();
+	if (!n)
+		usage();
+	return n;
+}
+
+int main(int argc, char** argv) {
+	usbaspUploadOptions_t options;
+	usbaspUploadStats_t stats;
+	usbaspTransport_t* t;
+	uint64_t read, rle;
+	const char* depths = "1,2,4";
+	const char* blocks = "256,4096";
+	const char *d, *b;
+	unsigned long generated = 0, pages, block;
+	int c, r, failed = 0;
+
+	usbaspUploadDefaults(&options);
+	while ((c = getopt(argc, argv, "ut:s:d:b:g:")) != -1) {
+		switch (c) {
+		case 'u': usb = 1; break;
+		case 't': tty = optarg; break;
+		case 's': serial = optarg; break;
+		case 'd': depths = optarg; break;
+		case 'b': blocks = optarg; break;
+		case 'g': generated = strtoul(optarg, 0, 0); break;
+		default: usage();
+		}
+	}
+	if (!generated && (optind != argc - 1))
+		usage();
+	for (b = blocks; (block = listNext(&b)); ) {
+		if ((block % USBASP_HOST_PAGESIZE) || (block > USBASP_MAX_BLOCKSIZE))
+			usage();
+	}
+	for (d = depths; listNext(&d); );
+
+	printf("%-6s %-6s %10s %10s %8s %9s %9s %10s %9s %10s %10s  %s\n", "block", "depth",
+			"erase ms", "write ms", "ms/page", "block ms", "max ms", "verify ms", "kB/s",
+			"read ms", "rle ms", "result");
+	for (b = blocks; (block = listNext(&b)); ) {
+		options.block = block;
+
+		for (d = depths; (options.depth = listNext(&d)); ) {
+			r = benchOpen(&t);
+			if (r < 0) {
+				fprintf(stderr, "no device\n");
+				return 1;
+			}
+
+			/* the loader runs alongside the upload, so reload for every run */
+			if (generated)
+				generate(t, generated);
+			else if (usbaspImageLoadAsync(&image, argv[optind]) < 0)
+				return 1;
+
+			read = rle = 0;
+			r = usbaspUpload(t, &image, &options, &stats);
+			if (r == USBASP_HOST_OK)
+				r = readback(t, &read);
+			if (r == USBASP_HOST_OK)
+				r = readbackRle(t, &rle);
+			t->close(t);
+
+			/* what a page costs the host, erase-ahead hides the erase in
+			 * it, and a block from submit to completion, queueing included */
+			pages = stats.bytes / USBASP_HOST_PAGESIZE;
+			printf("%-6lu %-6d %10.1f %10.1f %8.2f %9.2f %9.2f %10.1f %9.1f %10.1f %10.1f  %s\n",
+					block, options.depth, stats.erase / 1e6, stats.write / 1e6,
+					pages ? stats.write / 1e6 / pages : 0.0,
+					stats.transfers ? stats.latency / 1e6 / stats.transfers : 0.0,
+					stats.latencymax / 1e6, stats.verify / 1e6,
+					stats.write ? stats.bytes / 1.024 / (stats.write / 1e6) : 0.0,
+					read / 1e6, rle / 1e6, (r == USBASP_HOST_OK) ? "ok" : "FAILED");
+			if (r != USBASP_HOST_OK)
+				failed = 1;
+		}
+	}
+
+	for (b = blocks; (block = listNext(&b)); ) {
+		r = benchOpen(&t);
+		if (r == USBASP_HOST_OK) {
+			r = longAddress(t, block);
+			t->close(t);
+		}
+		if (r != USBASP_HOST_OK) {
+			fprintf(stderr, "upper 64 KB comparison with %lu byte blocks failed\n", block);
+			failed = 1;
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,411 @@
+/*
+ * client.c - part of USBasp bootloader host tools
+ *
+ * Description....: Requests and the pipelined upload
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "usbasphost.h"
+
+#define RQ_VENDOR_OUT   0x40
+#define RQ_VENDOR_IN    0xc0
+
+static void clientSetup(uint8_t* setup, uint8_t request, uint16_t value, uint16_t index,
+		uint16_t length, uint8_t in) {
+	setup[0] = in ? RQ_VENDOR_IN : RQ_VENDOR_OUT;
+	setup[1] = request;
+	setup[2] = value;
+	setup[3] = value >> 8;
+	setup[4] = index;
+	setup[5] = index >> 8;
+	setup[6] = length;
+	setup[7] = length >> 8;
+}
+
+static void clientDone(usbaspTransfer_t* transfer) {
+	*(uint8_t*)transfer->user = 1;
+}
+
+int usbaspControlSetup(usbaspTransport_t* t, const uint8_t* setup, uint8_t* data) {
+	usbaspTransfer_t transfer;
+	uint8_t finished = 0;
+	int r;
+
+	memset(&transfer, 0, sizeof(transfer));
+	memcpy(transfer.setup, setup, sizeof(transfer.setup));
+	transfer.data = data;
+	transfer.done = clientDone;
+	transfer.user = &finished;
+
+	r = t->submit(t, &transfer);
+	if (r < 0)
+		return r;
+	while (!finished) {
+		r = t->events(t, 1000);
+		if (r < 0)
+			return r;
+	}
+	return transfer.result;
+}
+
+int usbaspControl(usbaspTransport_t* t, uint8_t request, uint16_t value, uint16_t index,
+		uint8_t* data, uint16_t length, uint8_t in) {
+	uint8_t setup[8];
+
+	clientSetup(setup, request, value, index, length, in);
+	return usbaspControlSetup(t, setup, data);
+}
+
+int usbaspGetGeometry(usbaspTransport_t* t, usbaspGeometry_t* geometry) {
+	int r = usbaspControl(t, USBASP_FUNC_GETGEOMETRY, 0, 0, (void*)geometry, sizeof(*geometry), 1);
+
+	return (r == sizeof(*geometry)) ? USBASP_HOST_OK : ((r < 0) ? r : USBASP_HOST_EIO);
+}
+
+int usbaspGetWindow(usbaspTransport_t* t) {
+	usbaspGeometry_t geometry;
+	usbaspSlots_t slots;
+	int r;
+
+	r = usbaspGetGeometry(t, &geometry);
+	if (r < 0)
+		return r;
+
+	/* only the inactive slot can be written, the same choice as slotsOpen() */
+	t->flashstart = 0;
+	if (geometry.features & USBASP_FEATURE_ABSLOTS) {
+		r = usbaspControl(t, USBASP_FUNC_GETSLOTS, 0, 0, (void*)&slots, sizeof(slots), 1);
+		if (r != sizeof(slots))
+			return (r < 0) ? r : USBASP_HOST_EIO;
+		t->flashstart = slots.base[(slots.active == 0) ? 1 : 0];
+	}
+	t->flashend = t->flashstart + geometry.flashsize;
+	if (t->flashend > USBASP_HOST_FLASHSIZE)
+		t->flashend = USBASP_HOST_FLASHSIZE;
+	return USBASP_HOST_OK;
+}
+
+int usbaspGetIdentity(usbaspTransport_t* t, usbaspIdentity_t* identity) {
+	int r = usbaspControl(t, USBASP_FUNC_GETIDENTITY, 0, 0, (void*)identity, sizeof(*identity), 1);
+
+	return (r == sizeof(*identity)) ? USBASP_HOST_OK : ((r < 0) ? r : USBASP_HOST_EIO);
+}
+
+int usbaspCrc32(usbaspTransport_t* t, uint16_t page, uint16_t pages, uint32_t* crc) {
+	uint8_t reply[4];
+	int r = usbaspControl(t, USBASP_FUNC_CRC32, page, pages, reply, sizeof(reply), 1);
+
+	if (r != sizeof(reply))
+		return (r < 0) ? r : USBASP_HOST_EIO;
+	*crc = reply[0] | (reply[1] << 8) | ((uint32_t) reply[2] << 16) | ((uint32_t) reply[3] << 24);
+	return USBASP_HOST_OK;
+}
+
+/* the avrdude chip erase command, then poll until the background erase is
+ * done */
+int usbaspChipErase(usbaspTransport_t* t) {
+	uint8_t reply[4];
+	int r;
+
+	r = usbaspControl(t, USBASP_FUNC_TRANSMIT, 0x80ac, 0, reply, sizeof(reply), 1);
+	if (r < 0)
+		return r;
+	do {
+		r = usbaspControl(t, USBASP_FUNC_TRANSMIT, 0x00f0, 0, reply, sizeof(reply), 1);
+		if (r < 0)
+			return r;
+	} while (reply[3]);
+	return USBASP_HOST_OK;
+}
+
+int usbaspDisconnect(usbaspTransport_t* t) {
+	int r = usbaspControl(t, USBASP_FUNC_DISCONNECT, 0, 0, 0, 0, 1);
+
+	return (r < 0) ? r : USBASP_HOST_OK;
+}
+
+long usbaspRleDecode(const uint8_t* in, int n, uint8_t* out, unsigned long max) {
+	unsigned long decoded = 0;
+	int i = 0;
+
+	while (i < n) {
+		if (in[i] != USBASP_RLE_ESCAPE) {
+			if (decoded == max)
+				return USBASP_HOST_EIO;
+			out[decoded++] = in[i++];
+			continue;
+		}
+		/* a triple is never split across replies */
+		if ((i + 3 > n) || !in[i + 1] || (in[i + 1] > max - decoded))
+			return USBASP_HOST_EIO;
+		memset(&out[decoded], in[i + 2], in[i + 1]);
+		decoded += in[i + 1];
+		i += 3;
+	}
+	return decoded;
+}
+
+int usbaspReadRle(usbaspTransport_t* t, unsigned long address, uint8_t* data,
+		unsigned long length, uint16_t block) {
+	uint8_t* buffer = malloc(block);
+	uint16_t cover;
+	long decoded;
+	int r = USBASP_HOST_OK;
+
+	if (!buffer)
+		return USBASP_HOST_EIO;
+
+	while (length) {
+		r = usbaspControl(t, USBASP_FUNC_SETLONGADDRESS, address, address >> 16, 0, 0, 1);
+		if (r < 0)
+			break;
+		cover = (length > 0xffff) ? 0xffff : length;
+		r = usbaspControl(t, USBASP_FUNC_READFLASH_RLE, address, cover, buffer, block, 1);
+		if (r < 0)
+			break;
+		decoded = usbaspRleDecode(buffer, r, data, cover);
+		if (decoded <= 0) {
+			r = USBASP_HOST_EIO;
+			break;
+		}
+		/* the next request continues after the last decoded byte */
+		address += decoded;
+		data += decoded;
+		length -= decoded;
+		r = USBASP_HOST_OK;
+	}
+	free(buffer);
+	return r;
+}
+
+uint32_t usbaspHostCrc32(uint32_t crc, const uint8_t* data, unsigned long length) {
+	uint8_t i;
+
+	crc = ~crc;
+	while (length--) {
+		crc ^= *data++;
+		for (i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+		}
+	}
+	return ~crc;
+}
+
+void usbaspUploadDefaults(usbaspUploadOptions_t* options) {
+	memset(options, 0, sizeof(*options));
+	options->depth = 4;
+	options->block = 2048;
+	options->erase = 1;
+	options->verify = 1;
+}
+
+typedef struct {
+	usbaspTransport_t* t;
+	usbaspImage_t* image;
+	const usbaspUploadOptions_t* options;
+	usbaspUploadStats_t* stats;
+
+	uint16_t page;          /* next page to look at */
+	unsigned long total;
+	unsigned long written;
+	int inflight;
+	int status;
+	uint8_t ended;          /* no more blocks */
+	uint8_t nextsequential; /* the last block queued is followed directly */
+} uploadState_t;
+
+static void uploadDone(usbaspTransfer_t* transfer) {
+	uploadState_t* s = transfer->user;
+	uint16_t length = transfer->setup[6] | (transfer->setup[7] << 8);
+
+	uint64_t latency = s->t->clock(s->t) - transfer->submitted;
+
+	s->inflight--;
+	if (transfer->result != length) {
+		if (s->status == USBASP_HOST_OK)
+			s->status = (transfer->result < 0) ? transfer->result : USBASP_HOST_EIO;
+	} else {
+		if (!s->stats->transfers || (latency < s->stats->latencymin))
+			s->stats->latencymin = latency;
+		if (latency > s->stats->latencymax)
+			s->stats->latencymax = latency;
+		s->stats->latency += latency;
+		s->written += length;
+		s->stats->bytes += length;
+		s->stats->transfers++;
+		if (s->options->progress)
+			s->options->progress(s->options->user, s->written, s->total);
+	}
+	free(transfer);
+}
+
+/* find the next run of used pages and queue up to a block of it, returns 0
+ * once the image is done */
+static uint8_t uploadNext(uploadState_t* s) {
+	uint16_t pages = s->options->block / USBASP_HOST_PAGESIZE;
+	uint16_t end = s->t->flashend / USBASP_HOST_PAGESIZE;
+	uint16_t first, n;
+	unsigned long address;
+	usbaspTransfer_t* transfer;
+	uint8_t flags;
+
+	while (1) {
+		if (s->page >= USBASP_HOST_PAGES)
+			return 0;
+		if (!usbaspImageWait(s->image, (unsigned long)(s->page + 1) * USBASP_HOST_PAGESIZE)) {
+			s->status = USBASP_HOST_EFILE;
+			return 0;
+		}
+		if (usbaspImagePageUsed(s->image, s->page))
+			break;
+		s->page++;
+	}
+
+	first = s->page;
+	if ((first < s->t->flashstart / USBASP_HOST_PAGESIZE) || (first >= end)) {
+		s->status = USBASP_HOST_ERANGE;
+		return 0;
+	}
+	for (n = 1; (n < pages) && (first + n < end); n++) {
+		if (!usbaspImageWait(s->image, (unsigned long)(first + n + 1) * USBASP_HOST_PAGESIZE)) {
+			s->status = USBASP_HOST_EFILE;
+			return 0;
+		}
+		if (!usbaspImagePageUsed(s->image, first + n))
+			break;
+	}
+	s->page = first + n;
+
+	/* tell the device to erase ahead if the next block follows directly */
+	flags = 0;
+	if ((s->page < USBASP_HOST_PAGES)
+			&& usbaspImageWait(s->image, (unsigned long)(s->page + 1) * USBASP_HOST_PAGESIZE)
+			&& usbaspImagePageUsed(s->image, s->page))
+		flags |= PROG_BLOCKFLAG_SEQUENTIAL;
+
+	transfer = calloc(1, sizeof(*transfer));
+	if (!transfer) {
+		s->status = USBASP_HOST_EIO;
+		return 0;
+	}
+	address = (unsigned long) first * USBASP_HOST_PAGESIZE;
+	clientSetup(transfer->setup, USBASP_FUNC_WRITEFLASH_LONG, address,
+			((address >> 16) & 0xff) | (flags << 8), n * USBASP_HOST_PAGESIZE, 0);
+	transfer->data = &s->image->data[address];
+	transfer->done = uploadDone;
+	transfer->user = s;
+
+	if (s->t->submit(s->t, transfer) < 0) {
+		free(transfer);
+		s->status = USBASP_HOST_EIO;
+		return 0;
+	}
+	s->inflight++;
+	return 1;
+}
+
+static unsigned long uploadTotal(usbaspImage_t* image) {
+	unsigned long total = 0;
+	uint16_t page;
+
+	for (page = 0; page < USBASP_HOST_PAGES; page++) {
+		if (usbaspImagePageUsed(image, page))
+			total += USBASP_HOST_PAGESIZE;
+	}
+	return total;
+}
+
+int usbaspUpload(usbaspTransport_t* t, usbaspImage_t* image,
+		const usbaspUploadOptions_t* options, usbaspUploadStats_t* stats) {
+	uploadState_t s;
+	uint64_t start;
+	int r;
+
+	memset(stats, 0, sizeof(*stats));
+	memset(&s, 0, sizeof(s));
+	s.t = t;
+	s.image = image;
+	s.options = options;
+	s.stats = stats;
+	s.status = USBASP_HOST_OK;
+
+	if (image->done) {
+		r = usbaspImageCheck(image, t);
+		if (r < 0)
+			return r;
+	}
+
+	if (options->erase) {
+		start = t->clock(t);
+		r = usbaspChipErase(t);
+		if (r < 0)
+			return r;
+		stats->erase = t->clock(t) - start;
+	}
+
+	/* the total is only known once the file is loaded, progress reports
+	 * 0 until then */
+	start = t->clock(t);
+	while (1) {
+		while (!s.ended && (s.status == USBASP_HOST_OK) && (s.inflight < options->depth)) {
+			if (!s.total && image->done)
+				s.total = uploadTotal(image);
+			if (!uploadNext(&s))
+				s.ended = 1;
+		}
+		if (!s.inflight)
+			break;
+		r = t->events(t, 1000);
+		if (r < 0) {
+			s.status = r;
+			break;
+		}
+	}
+	stats->write = t->clock(t) - start;
+
+	if (s.status != USBASP_HOST_OK)
+		return s.status;
+
+	r = usbaspImageFinish(image);
+	if (r < 0)
+		return r;
+
+	if (options->verify) {
+		start = t->clock(t);
+		r = usbaspVerify(t, image);
+		stats->verify = t->clock(t) - start;
+		if (r < 0)
+			return r;
+	}
+	return USBASP_HOST_OK;
+}
+
+int usbaspVerify(usbaspTransport_t* t, const usbaspImage_t* image) {
+	uint16_t first, page = 0;
+	uint32_t crc;
+	int r;
+
+	while (page < USBASP_HOST_PAGES) {
+		if (!usbaspImagePageUsed(image, page)) {
+			page++;
+			continue;
+		}
+		first = page;
+		while ((page < USBASP_HOST_PAGES) && usbaspImagePageUsed(image, page)) {
+			page++;
+		}
+
+		r = usbaspCrc32(t, first, page - first, &crc);
+		if (r < 0)
+			return r;
+		if (crc != usbaspHostCrc32(0, &image->data[(unsigned long) first * USBASP_HOST_PAGESIZE],
+				(unsigned long)(page - first) * USBASP_HOST_PAGESIZE))
+			return USBASP_HOST_EVERIFY;
+	}
+	return USBASP_HOST_OK;
+}
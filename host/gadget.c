@@ -0,0 +1,350 @@
+/*
+ * gadget.c - part of USBasp bootloader host tools
+ *
+ * Description....: The simulated bootloader as a real USB device through
+ *                  FunctionFS, e.g. on dummy_hcd
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mount.h>
+#include <linux/usb/ch9.h>
+#include <linux/usb/functionfs.h>
+
+#include "usbasphost.h"
+#include "sim/simdev.h"
+
+#define GADGET_CONFIGFS "/sys/kernel/config/usb_gadget/usbasp"
+#define GADGET_FUNCTION "ffs.usbasp"
+
+/* The device descriptor comes from the composite driver, so VID, PID,
+ * version and strings from usbids.h and the class of
+ * ram_usbDescriptorDevice (main.c, without HID) are set up in configfs. FunctionFS only describes the interface,
+ * which has no endpoints besides the control pipe. */
+static const struct {
+	struct usb_functionfs_descs_head_v2 header;
+	uint32_t fs_count;
+	uint32_t hs_count;
+	struct usb_interface_descriptor fs_intf;
+	struct usb_interface_descriptor hs_intf;
+} __attribute__((packed)) descriptors = {
+	.header = {
+		.magic = FUNCTIONFS_DESCRIPTORS_MAGIC_V2,
+		.length = sizeof(descriptors),
+		/* vendor requests to the device go to the function as well */
+		.flags = FUNCTIONFS_HAS_FS_DESC | FUNCTIONFS_HAS_HS_DESC | FUNCTIONFS_ALL_CTRL_RECIP,
+	},
+	.fs_count = 1,
+	.hs_count = 1,
+	.fs_intf = {
+		.bLength = sizeof(struct usb_interface_descriptor),
+		.bDescriptorType = USB_DT_INTERFACE,
+		.bInterfaceClass = 0,
+	},
+	.hs_intf = {
+		.bLength = sizeof(struct usb_interface_descriptor),
+		.bDescriptorType = USB_DT_INTERFACE,
+		.bInterfaceClass = 0,
+	},
+};
+
+static const struct usb_functionfs_strings_head strings = {
+	.magic = FUNCTIONFS_STRINGS_MAGIC,
+	.length = sizeof(strings),
+	.str_count = 0,
+	.lang_count = 0,
+};
+
+static volatile sig_atomic_t stop;
+static uint8_t fast;
+static int64_t offset;          /* wall clock minus bus time */
+static uint8_t data[0x10000];
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: usbasp-gadget [-c] [-u udc] [-s serial] [-f state] [-z] mountpoint\n"
+		"  -c        create the gadget in configfs and mount FunctionFS first\n"
+		"  -u        UDC to bind to with -c, default the first one, e.g. dummy_udc.0\n"
+		"  -s        serial number for the signature row, hex, default 42\n"
+		"  -f        load flash and EEPROM from this file and save them on exit\n"
+		"  -z        answer at once instead of taking as long as the part would\n");
+	exit(2);
+}
+
+static void gadgetSignal(int sig) {
+	(void) sig;
+	stop = 1;
+}
+
+static uint64_t gadgetClock(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* wait until the wall clock has caught up with the bus time */
+static void gadgetWait(uint64_t bus) {
+	struct timespec ts;
+	uint64_t t = bus + offset;
+
+	if (fast)
+		return;
+	ts.tv_sec = t / 1000000000ULL;
+	ts.tv_nsec = t % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR) {
+		if (stop)
+			return;
+	}
+}
+
+static uint8_t gadgetWrite(const char* dir, const char* name, const char* value) {
+	char path[512];
+	int fd, n;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		return 0;
+	}
+	n = write(fd, value, strlen(value));
+	close(fd);
+	if (n < 0) {
+		perror(path);
+		return 0;
+	}
+	return 1;
+}
+
+static uint8_t gadgetMkdir(const char* path) {
+	if ((mkdir(path, 0755) < 0) && (errno != EEXIST)) {
+		perror(path);
+		return 0;
+	}
+	return 1;
+}
+
+/* the gadget with ram_usbDescriptorDevice's IDs and strings, needs
+ * libcomposite and usb_f_fs */
+static uint8_t gadgetCreate(const char* serial, const char* mountpoint) {
+	static const char vendor[] = { USBASP_USB_VENDOR_NAME, 0 };
+	static const char product[] = { USBASP_USB_DEVICE_NAME, 0 };
+	const char* g = GADGET_CONFIGFS;
+	char vid[8], pid[8], version[8];
+
+	snprintf(vid, sizeof(vid), "0x%04x", USBASP_USB_VID);
+	snprintf(pid, sizeof(pid), "0x%04x", USBASP_USB_PID);
+	snprintf(version, sizeof(version), "0x%04x", USBASP_USB_VERSION);
+
+	if (!gadgetMkdir(g)
+			|| !gadgetWrite(g, "idVendor", vid)
+			|| !gadgetWrite(g, "idProduct", pid)
+			|| !gadgetWrite(g, "bcdDevice", version)
+			|| !gadgetWrite(g, "bcdUSB", "0x0110")
+			|| !gadgetWrite(g, "bDeviceClass", "0xff")
+			|| !gadgetMkdir(GADGET_CONFIGFS "/strings/0x409")
+			|| !gadgetWrite(g, "strings/0x409/manufacturer", vendor)
+			|| !gadgetWrite(g, "strings/0x409/product", product)
+			|| !gadgetWrite(g, "strings/0x409/serialnumber", serial)
+			|| !gadgetMkdir(GADGET_CONFIGFS "/configs/c.1")
+			|| !gadgetWrite(g, "configs/c.1/MaxPower", "50")
+			|| !gadgetMkdir(GADGET_CONFIGFS "/functions/" GADGET_FUNCTION))
+		return 0;
+
+	if ((symlink(GADGET_CONFIGFS "/functions/" GADGET_FUNCTION,
+			GADGET_CONFIGFS "/configs/c.1/" GADGET_FUNCTION) < 0) && (errno != EEXIST)) {
+		perror("configs/c.1");
+		return 0;
+	}
+	if ((mkdir(mountpoint, 0755) < 0) && (errno != EEXIST)) {
+		perror(mountpoint);
+		return 0;
+	}
+	if ((mount("usbasp", mountpoint, "functionfs", 0, 0) < 0) && (errno != EBUSY)) {
+		perror(mountpoint);
+		return 0;
+	}
+	return 1;
+}
+
+/* the UDC can only be bound once FunctionFS has its descriptors */
+static uint8_t gadgetBind(const char* udc) {
+	struct dirent* entry;
+	char name[256] = "";
+	DIR* dir;
+
+	if (!udc) {
+		dir = opendir("/sys/class/udc");
+		while (dir && (entry = readdir(dir))) {
+			if (entry->d_name[0] != '.') {
+				snprintf(name, sizeof(name), "%s", entry->d_name);
+				break;
+			}
+		}
+		if (dir)
+			closedir(dir);
+		if (!name[0]) {
+			fprintf(stderr, "no UDC, load dummy_hcd or name one with -u\n");
+			return 0;
+		}
+		udc = name;
+	}
+	return gadgetWrite(GADGET_CONFIGFS, "UDC", udc);
+}
+
+/* FunctionFS stalls a control transfer on a read or write against its
+ * direction */
+static void gadgetStall(int ep0, const struct usb_ctrlrequest* setup) {
+	uint8_t dummy;
+
+	if (setup->bRequestType & USB_DIR_IN)
+		(void) !read(ep0, &dummy, 0);
+	else
+		(void) !write(ep0, &dummy, 0);
+}
+
+/* The OUT data stage is already acknowledged once FunctionFS hands it over,
+ * so the device's time for it is waited out before the next request is
+ * taken instead, and a stall from the engine can't be reported. */
+static void gadgetSetup(int ep0, const struct usb_ctrlrequest* setup) {
+	uint16_t length = setup->wLength;
+	uint64_t start, done;
+	int r;
+
+	if (!(setup->bRequestType & USB_DIR_IN) && length) {
+		r = read(ep0, data, length);
+		if (r != length)
+			return;
+	}
+
+	start = fast ? 0 : gadgetClock() - offset;
+	r = simDeviceControl((const uint8_t*) setup, data, start, &done);
+	gadgetWait(done);
+
+	if (r == SIM_STALL) {
+		gadgetStall(ep0, setup);
+	} else if (setup->bRequestType & USB_DIR_IN) {
+		(void) !write(ep0, data, r);
+	} else if (!length) {
+		(void) !read(ep0, data, 0);
+	}
+}
+
+/* returns the bus time after the request */
+static uint64_t gadgetSerial(char* serial) {
+	static const uint8_t setup[8] = { 0xc0, USBASP_FUNC_GETIDENTITY, 0, 0, 0, 0,
+			sizeof(usbaspIdentity_t), 0 };
+	usbaspIdentity_t identity;
+	uint64_t done;
+	uint8_t i, nibble;
+
+	simDeviceControl(setup, (uint8_t*)&identity, 0, &done);
+	for (i = 0; i < 2 * USBASP_SERIAL_LEN; i++) {
+		nibble = (i & 1) ? (identity.serial[i >> 1] & 0x0f) : (identity.serial[i >> 1] >> 4);
+		serial[i] = (nibble < 10) ? ('0' + nibble) : ('A' + nibble - 10);
+	}
+	serial[i] = 0;
+	return done;
+}
+
+int main(int argc, char** argv) {
+	struct usb_functionfs_event events[4];
+	struct sigaction action;
+	char serial[USBASP_HOST_SERIALLEN];
+	char path[512];
+	const char* udc = 0;
+	const char* state = 0;
+	uint32_t simserial = 0x42;
+	uint64_t bus;
+	uint8_t create = 0;
+	int c, ep0, n, i, r = 0;
+
+	while ((c = getopt(argc, argv, "cu:s:f:z")) != -1) {
+		switch (c) {
+		case 'c': create = 1; break;
+		case 'u': udc = optarg; break;
+		case 's': simserial = strtoul(optarg, 0, 16); break;
+		case 'f': state = optarg; break;
+		case 'z': fast = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+
+	simDeviceInit(simserial);
+	if (state && (access(state, F_OK) == 0)) {
+		if (!simDeviceLoad(state)) {
+			fprintf(stderr, "%s: can't load\n", state);
+			return 1;
+		}
+		simDeviceRestart();
+	}
+	/* the serial number may have been set in EEPROM */
+	bus = gadgetSerial(serial);
+
+	if (create && !gadgetCreate(serial, argv[optind]))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/ep0", argv[optind]);
+	ep0 = open(path, O_RDWR);
+	if (ep0 < 0) {
+		perror(path);
+		return 1;
+	}
+	if ((write(ep0, &descriptors, sizeof(descriptors)) < 0)
+			|| (write(ep0, &strings, sizeof(strings)) < 0)) {
+		perror("FunctionFS descriptors");
+		return 1;
+	}
+	if (create && !gadgetBind(udc))
+		return 1;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = gadgetSignal;
+	sigaction(SIGINT, &action, 0);
+	sigaction(SIGTERM, &action, 0);
+
+	printf("USBasp bootloader %s is up\n", serial);
+	fflush(stdout);
+	offset = fast ? 0 : gadgetClock() - bus;
+
+	while (!stop && !simDeviceGone()) {
+		n = read(ep0, events, sizeof(events));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("ep0");
+			r = 1;
+			break;
+		}
+		for (i = 0; i < n / (int) sizeof(events[0]); i++) {
+			if (events[i].type == FUNCTIONFS_SETUP)
+				gadgetSetup(ep0, &events[i].u.setup);
+		}
+	}
+
+	if (simDeviceGone())
+		printf("application started\n");
+	if (create)
+		gadgetWrite(GADGET_CONFIGFS, "UDC", "\n");
+	close(ep0);
+
+	if (state && !simDeviceSave(state)) {
+		fprintf(stderr, "%s: can't save\n", state);
+		r = 1;
+	}
+	return r;
+}
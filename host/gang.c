@@ -0,0 +1,149 @@
+/*
+ * gang.c - part of USBasp bootloader host tools
+ *
+ * Description....: Programs all attached bootloaders in parallel
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "usbasphost.h"
+
+#define GANG_MAX        64
+
+typedef struct {
+	char serial[USBASP_HOST_SERIALLEN];
+	uint32_t simserial;     /* 0 for attached devices */
+	usbaspTransport_t* t;
+	pthread_t thread;
+	usbaspUploadStats_t stats;
+	int result;
+} gangWorker_t;
+
+/* parsed once, the workers only read it */
+static usbaspImage_t image;
+static usbaspUploadOptions_t options;
+static uint8_t leave;
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: usbasp-gang [-n count] [-d depth] [-b block] [-x] image\n"
+		"  -n        program that many simulated devices instead of attached ones\n"
+		"  -d        transfers kept queued per device, default 4\n"
+		"  -b        bytes per write request, default 2048\n"
+		"  -x        start the application on every device that verified\n");
+	exit(2);
+}
+
+static const char* gangError(int r) {
+	switch (r) {
+	case USBASP_HOST_OK: return "ok";
+	case USBASP_HOST_ESTALL: return "request refused";
+	case USBASP_HOST_EGONE: return "device left the bus";
+	case USBASP_HOST_EVERIFY: return "verify FAILED";
+	case USBASP_HOST_ENODEV: return "can't open";
+	case USBASP_HOST_ERANGE: return "image outside the writable window";
+	default: return "transfer failed";
+	}
+}
+
+/* Simulated devices are child processes, which must not be forked from a
+ * multithreaded process, so every device is opened before the image loader
+ * and the workers start. */
+static void gangOpen(gangWorker_t* w) {
+	if (w->simserial)
+		w->result = usbaspOpenSim(&w->t, w->simserial);
+	else
+		w->result = usbaspOpenUsb(&w->t, w->serial);
+	if (w->result < 0)
+		w->t = 0;
+	else if (w->simserial)
+		memcpy(w->serial, w->t->serial, sizeof(w->serial));
+}
+
+static void* gangThread(void* arg) {
+	gangWorker_t* w = arg;
+
+	w->result = usbaspUpload(w->t, &image, &options, &w->stats);
+	if ((w->result == USBASP_HOST_OK) && leave)
+		w->result = usbaspDisconnect(w->t);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	static gangWorker_t workers[GANG_MAX];
+	char serials[GANG_MAX][USBASP_HOST_SERIALLEN];
+	uint64_t longest = 0, total;
+	int c, i, n = 0, sim = 0, failed = 0;
+
+	usbaspUploadDefaults(&options);
+	while ((c = getopt(argc, argv, "n:d:b:x")) != -1) {
+		switch (c) {
+		case 'n': sim = atoi(optarg); break;
+		case 'd': options.depth = atoi(optarg); break;
+		case 'b': options.block = strtoul(optarg, 0, 0) & ~(USBASP_HOST_PAGESIZE - 1); break;
+		case 'x': leave = 1; break;
+		default: usage();
+		}
+	}
+	if ((optind != argc - 1) || (options.depth < 1) || !options.block
+			|| (options.block > USBASP_MAX_BLOCKSIZE) || (sim < 0) || (sim > GANG_MAX))
+		usage();
+
+	if (sim) {
+		for (i = 0; i < sim; i++) {
+			workers[n].simserial = 0x100 + i;
+			snprintf(workers[n++].serial, USBASP_HOST_SERIALLEN, "sim %d", i);
+		}
+	} else {
+		n = usbaspListUsb(serials, GANG_MAX);
+		for (i = 0; i < n; i++) {
+			memcpy(workers[i].serial, serials[i], USBASP_HOST_SERIALLEN);
+		}
+	}
+	if (!n) {
+		fprintf(stderr, "no bootloader found\n");
+		return 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		gangOpen(&workers[i]);
+	}
+	/* the image is read by a thread of its own as well */
+	if (usbaspImageLoad(&image, argv[optind]) < 0) {
+		fprintf(stderr, "%s: can't read image\n", argv[optind]);
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		if (!workers[i].t)
+			continue;
+		if (pthread_create(&workers[i].thread, 0, gangThread, &workers[i]) != 0) {
+			workers[i].result = USBASP_HOST_EIO;
+			workers[i].thread = 0;
+		}
+	}
+
+	printf("%-20s %10s %10s %10s  %s\n", "serial", "erase ms", "write ms", "verify ms", "result");
+	for (i = 0; i < n; i++) {
+		if (workers[i].thread)
+			pthread_join(workers[i].thread, 0);
+		if (workers[i].t)
+			workers[i].t->close(workers[i].t);
+		total = workers[i].stats.erase + workers[i].stats.write + workers[i].stats.verify;
+		if (total > longest)
+			longest = total;
+		if (workers[i].result != USBASP_HOST_OK)
+			failed++;
+		printf("%-20s %10.1f %10.1f %10.1f  %s\n", workers[i].serial,
+				workers[i].stats.erase / 1e6, workers[i].stats.write / 1e6,
+				workers[i].stats.verify / 1e6, gangError(workers[i].result));
+	}
+	printf("%d of %d devices ok, slowest took %.1f ms\n", n - failed, n, longest / 1e6);
+	return failed ? 1 : 0;
+}
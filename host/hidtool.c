@@ -0,0 +1,129 @@
+/*
+ * hidtool.c - part of USBasp bootloader host tools
+ *
+ * Description....: Upload through hidraw and compare with USBasp requests
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "usbasphost.h"
+
+static usbaspImage_t image;
+
+static const char* path = 0;
+static uint8_t simulated = 0;
+static unsigned long generated = 0;
+static const char* file = 0;
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: usbasp-hid [-n | -p hidraw] [-g bytes | image]\n"
+		"  -n        use simulated devices instead of attached ones\n"
+		"  -p        hidraw node of the HID build, default the first one found\n"
+		"  -g        generate a pseudo random image of that size\n"
+		"The image goes to the HID build through its feature reports, then the\n"
+		"same upload runs with USBasp requests of 256 and 4096 bytes through\n"
+		"libusb (an attached USBasp build) or on simulated devices with -n.\n");
+	exit(2);
+}
+
+/* deterministic test content up to the end of the writable window */
+static void generate(const usbaspTransport_t* t, unsigned long size) {
+	unsigned long i;
+	uint32_t x = 12345;
+
+	if (size > t->flashend - t->flashstart)
+		size = t->flashend - t->flashstart;
+	memset(image.data, 0xff, sizeof(image.data));
+	memset(image.used, 0, sizeof(image.used));
+	for (i = t->flashstart; i < t->flashstart + size; i++) {
+		x = x * 1103515245 + 12345;
+		image.data[i] = x >> 16;
+		image.used[i / USBASP_HOST_PAGESIZE] = 1;
+	}
+	image.size = t->flashstart + size;
+	image.ready = USBASP_HOST_FLASHSIZE;
+	image.done = 1;
+	image.status = USBASP_HOST_OK;
+	pthread_mutex_init(&image.lock, 0);
+	pthread_cond_init(&image.changed, 0);
+}
+
+/* upload the image to t and print a row, closes t */
+static int run(usbaspTransport_t* t, const char* name, uint16_t block) {
+	usbaspUploadOptions_t options;
+	usbaspUploadStats_t stats;
+	unsigned long pages;
+	int r;
+
+	usbaspUploadDefaults(&options);
+	options.block = block;
+	/* the reports go one at a time, so the USBasp requests do too */
+	options.depth = 1;
+
+	if (generated) {
+		generate(t, generated);
+	} else if (usbaspImageLoadAsync(&image, file) < 0) {
+		t->close(t);
+		return USBASP_HOST_EFILE;
+	}
+	r = usbaspUpload(t, &image, &options, &stats);
+	t->close(t);
+
+	pages = stats.bytes / USBASP_HOST_PAGESIZE;
+	printf("%-14s %-6u %10.1f %10.1f %8.2f %10.1f %9.1f  %s\n",
+			name, block, stats.erase / 1e6, stats.write / 1e6,
+			pages ? stats.write / 1e6 / pages : 0.0, stats.verify / 1e6,
+			stats.write ? stats.bytes / 1.024 / (stats.write / 1e6) : 0.0,
+			(r == USBASP_HOST_OK) ? "ok" : "FAILED");
+	return r;
+}
+
+int main(int argc, char** argv) {
+	static const uint16_t blocks[] = { 256, 4096 };
+	usbaspTransport_t* t;
+	unsigned i;
+	int c, r, failed = 0;
+
+	while ((c = getopt(argc, argv, "np:g:")) != -1) {
+		switch (c) {
+		case 'n': simulated = 1; break;
+		case 'p': path = optarg; break;
+		case 'g': generated = strtoul(optarg, 0, 0); break;
+		default: usage();
+		}
+	}
+	if (!generated && (optind != argc - 1))
+		usage();
+	if (!generated)
+		file = argv[optind];
+
+	printf("%-14s %-6s %10s %10s %8s %10s %9s  %s\n", "protocol", "block",
+			"erase ms", "write ms", "ms/page", "verify ms", "kB/s", "result");
+
+	/* the upload's blocks are split into one report per page */
+	r = simulated ? usbaspOpenSimHid(&t, 0x42) : usbaspOpenHidraw(&t, path);
+	if (r < 0) {
+		fprintf(stderr, "no HID device\n");
+		return 1;
+	}
+	if (run(t, "HID reports", 4096) != USBASP_HOST_OK)
+		failed = 1;
+
+	for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+		r = simulated ? usbaspOpenSim(&t, 0x42) : usbaspOpenUsb(&t, 0);
+		if (r < 0) {
+			fprintf(stderr, "no USBasp device to compare with\n");
+			break;
+		}
+		if (run(t, "USBasp", blocks[i]) != USBASP_HOST_OK)
+			failed = 1;
+	}
+	return failed;
+}
@@ -0,0 +1,231 @@
+/*
+ * image.c - part of USBasp bootloader host tools
+ *
+ * Description....: Intel HEX and ELF loader with a background thread
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#include "usbasphost.h"
+
+/* publish how far the image is final, records below ready can't change */
+static void imageReady(usbaspImage_t* image, unsigned long ready) {
+	pthread_mutex_lock(&image->lock);
+	if (ready > image->ready)
+		image->ready = ready;
+	pthread_cond_broadcast(&image->changed);
+	pthread_mutex_unlock(&image->lock);
+}
+
+static uint8_t imageStore(usbaspImage_t* image, unsigned long address, const uint8_t* data,
+		unsigned long length) {
+	unsigned long i;
+
+	if ((address >= USBASP_HOST_FLASHSIZE) || (length > USBASP_HOST_FLASHSIZE - address))
+		return 0;
+
+	pthread_mutex_lock(&image->lock);
+	memcpy(&image->data[address], data, length);
+	for (i = 0; i < length; i++) {
+		if (data[i] != 0xff)
+			image->used[(address + i) / USBASP_HOST_PAGESIZE] = 1;
+	}
+	if (address + length > image->size)
+		image->size = address + length;
+	pthread_mutex_unlock(&image->lock);
+	return 1;
+}
+
+static int hexNibble(char c) {
+	if ((c >= '0') && (c <= '9'))
+		return c - '0';
+	if ((c >= 'a') && (c <= 'f'))
+		return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F'))
+		return c - 'A' + 10;
+	return -1;
+}
+
+static int imageLoadHex(usbaspImage_t* image, FILE* f) {
+	char line[600];
+	uint8_t record[256 + 5];
+	unsigned long base = 0, address, last = 0;
+	uint8_t ascending = 1, sum;
+	int i, n, hi, lo;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] != ':')
+			continue;
+
+		n = 0;
+		for (i = 1; (hi = hexNibble(line[i])) >= 0; i += 2) {
+			lo = hexNibble(line[i + 1]);
+			if ((lo < 0) || (n == sizeof(record)))
+				return USBASP_HOST_EFILE;
+			record[n++] = (hi << 4) | lo;
+		}
+		if ((n < 5) || (n != record[0] + 5))
+			return USBASP_HOST_EFILE;
+		for (sum = 0, i = 0; i < n; i++) {
+			sum += record[i];
+		}
+		if (sum)
+			return USBASP_HOST_EFILE;
+
+		switch (record[3]) {
+		case 0x00:
+			address = base + ((record[1] << 8) | record[2]);
+			if (!imageStore(image, address, &record[4], record[0]))
+				return USBASP_HOST_EFILE;
+			/* everything below a record is final as long as they ascend */
+			if (address < last)
+				ascending = 0;
+			last = address;
+			if (ascending)
+				imageReady(image, address & ~(USBASP_HOST_PAGESIZE - 1UL));
+			break;
+		case 0x01:
+			return USBASP_HOST_OK;
+		case 0x02:
+			base = ((record[4] << 8) | record[5]) << 4;
+			break;
+		case 0x04:
+			base = (unsigned long)((record[4] << 8) | record[5]) << 16;
+			break;
+		default:
+			break;
+		}
+	}
+	return USBASP_HOST_OK;
+}
+
+/* program headers of a 32 bit little endian ELF, as avr-gcc writes them */
+static int imageLoadElf(usbaspImage_t* image, FILE* f) {
+	Elf32_Ehdr header;
+	Elf32_Phdr segment;
+	uint8_t* data;
+	int i;
+
+	if ((fread(&header, sizeof(header), 1, f) != 1)
+			|| (header.e_ident[EI_CLASS] != ELFCLASS32)
+			|| (header.e_ident[EI_DATA] != ELFDATA2LSB)
+			|| (header.e_phentsize != sizeof(segment)))
+		return USBASP_HOST_EFILE;
+
+	for (i = 0; i < header.e_phnum; i++) {
+		if ((fseek(f, header.e_phoff + i * sizeof(segment), SEEK_SET) != 0)
+				|| (fread(&segment, sizeof(segment), 1, f) != 1))
+			return USBASP_HOST_EFILE;
+
+		/* .data is loaded from flash at its load address, RAM and EEPROM
+		 * sections sit at 0x800000 and up */
+		if ((segment.p_type != PT_LOAD) || !segment.p_filesz || (segment.p_paddr >= 0x800000))
+			continue;
+
+		data = malloc(segment.p_filesz);
+		if (!data)
+			return USBASP_HOST_EFILE;
+		if ((fseek(f, segment.p_offset, SEEK_SET) != 0)
+				|| (fread(data, segment.p_filesz, 1, f) != 1)
+				|| !imageStore(image, segment.p_paddr, data, segment.p_filesz)) {
+			free(data);
+			return USBASP_HOST_EFILE;
+		}
+		free(data);
+	}
+	return USBASP_HOST_OK;
+}
+
+static void* imageThread(void* arg) {
+	usbaspImage_t* image = arg;
+	uint8_t magic[4] = { 0 };
+	FILE* f;
+	int r = USBASP_HOST_EFILE;
+
+	f = fopen(image->path, "rb");
+	if (f) {
+		if (fread(magic, sizeof(magic), 1, f) == 1) {
+			rewind(f);
+			if (!memcmp(magic, ELFMAG, SELFMAG))
+				r = imageLoadElf(image, f);
+			else
+				r = imageLoadHex(image, f);
+		}
+		fclose(f);
+	}
+
+	pthread_mutex_lock(&image->lock);
+	image->status = r;
+	image->done = 1;
+	image->ready = USBASP_HOST_FLASHSIZE;
+	pthread_cond_broadcast(&image->changed);
+	pthread_mutex_unlock(&image->lock);
+	return 0;
+}
+
+static void imageInit(usbaspImage_t* image, const char* path) {
+	memset(image->data, 0xff, sizeof(image->data));
+	memset(image->used, 0, sizeof(image->used));
+	image->size = 0;
+	image->ready = 0;
+	image->status = USBASP_HOST_OK;
+	image->done = 0;
+	snprintf(image->path, sizeof(image->path), "%s", path);
+	pthread_mutex_init(&image->lock, 0);
+	pthread_cond_init(&image->changed, 0);
+}
+
+int usbaspImageLoadAsync(usbaspImage_t* image, const char* path) {
+	imageInit(image, path);
+	if (pthread_create(&image->thread, 0, imageThread, image) != 0)
+		return USBASP_HOST_EFILE;
+	return USBASP_HOST_OK;
+}
+
+int usbaspImageLoad(usbaspImage_t* image, const char* path) {
+	int r = usbaspImageLoadAsync(image, path);
+
+	return (r < 0) ? r : usbaspImageFinish(image);
+}
+
+uint8_t usbaspImageWait(usbaspImage_t* image, unsigned long address) {
+	uint8_t ok;
+
+	pthread_mutex_lock(&image->lock);
+	while (!image->done && (image->ready < address)) {
+		pthread_cond_wait(&image->changed, &image->lock);
+	}
+	ok = (image->status == USBASP_HOST_OK);
+	pthread_mutex_unlock(&image->lock);
+	return ok;
+}
+
+int usbaspImageFinish(usbaspImage_t* image) {
+	if (image->thread) {
+		pthread_join(image->thread, 0);
+		image->thread = 0;
+	}
+	return image->status;
+}
+
+uint8_t usbaspImagePageUsed(const usbaspImage_t* image, uint16_t page) {
+	return image->used[page];
+}
+
+int usbaspImageCheck(const usbaspImage_t* image, const usbaspTransport_t* t) {
+	uint16_t page;
+
+	for (page = 0; page < USBASP_HOST_PAGES; page++) {
+		if (usbaspImagePageUsed(image, page)
+				&& (((unsigned long) page * USBASP_HOST_PAGESIZE < t->flashstart)
+				|| ((unsigned long)(page + 1) * USBASP_HOST_PAGESIZE > t->flashend)))
+			return USBASP_HOST_ERANGE;
+	}
+	return USBASP_HOST_OK;
+}
@@ -0,0 +1,193 @@
+/*
+ * plan.c - part of USBasp bootloader host tools
+ *
+ * Description....: Plans the fastest request sequence for an image and
+ *                  checks the prediction against the simulated device
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "usbasphost.h"
+#include "sim/simhw.h"
+#include "sim/simdev.h"
+
+#define RQ_VENDOR_OUT   0x40
+
+/* one WRITEFLASH_LONG request */
+typedef struct {
+	uint16_t page;
+	uint16_t pages;
+	uint8_t flags;
+} planBlock_t;
+
+static usbaspImage_t image;
+static planBlock_t plan[USBASP_HOST_PAGES];
+static int blocks;
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: usbasp-plan [-b block] [-d depth] [-q] image\n"
+		"  -b        largest request in bytes, default and maximum 32768\n"
+		"  -d        transfers kept queued when run, default 4\n"
+		"  -q        don't list the requests\n");
+	exit(2);
+}
+
+/* Blank pages are left to the chip erase. The remaining pages form runs of
+ * adjacent pages, written in ascending order so every request can tell the
+ * device to erase ahead into the next one. A run is cut into as few
+ * requests as the block size allows. Writing a blank gap to join two runs
+ * never pays: a page costs more bus time than the setup and status stages
+ * of another request. */
+static void planBuild(uint16_t pagesPerBlock) {
+	uint16_t page = 0, end;
+
+	blocks = 0;
+	while (page < USBASP_HOST_PAGES) {
+		if (!usbaspImagePageUsed(&image, page)) {
+			page++;
+			continue;
+		}
+		for (end = page; (end < USBASP_HOST_PAGES) && usbaspImagePageUsed(&image, end); end++)
+			;
+		while (page < end) {
+			plan[blocks].page = page;
+			plan[blocks].pages = (end - page > pagesPerBlock) ? pagesPerBlock : end - page;
+			page += plan[blocks].pages;
+			plan[blocks].flags = (page < end) ? PROG_BLOCKFLAG_SEQUENTIAL : 0;
+			blocks++;
+		}
+	}
+}
+
+/* First order model of the simulated device, in ns. The device takes one
+ * 8 byte packet per SIM_USB_PACKET_NS plus its loop, and every flash page
+ * is erased and written once. With erase ahead the page's SPM time runs
+ * while the next page comes in, so a page costs whichever is longer. The
+ * first page of a run has no erase ahead and the last one's write isn't
+ * hidden behind anything. A single queued transfer adds the host's
+ * turnaround to every request. */
+static uint64_t planPredict(int depth) {
+	const uint64_t packet = SIM_USB_PACKET_NS + SIM_LOOP_NS;
+	const uint64_t spm = SIM_SPM_ERASE_NS + SIM_SPM_WRITE_NS;
+	const uint64_t page = USBASP_HOST_PAGESIZE / 8 * packet;
+	uint64_t t = 0;
+	int i;
+
+	for (i = 0; i < blocks; i++) {
+		t += 2 * packet + plan[i].pages * ((page > spm) ? page : spm);
+		if (depth == 1)
+			t += SIM_USB_TURNAROUND_NS;
+		if (!plan[i].flags)
+			t += SIM_SPM_ERASE_NS + SIM_SPM_WRITE_NS;
+	}
+	return t;
+}
+
+static void planDone(usbaspTransfer_t* transfer) {
+	int* inflight = transfer->user;
+
+	(*inflight)--;
+}
+
+/* run the plan, returns the time taken or 0 on failure */
+static uint64_t planRun(usbaspTransport_t* t, int depth) {
+	static usbaspTransfer_t transfers[USBASP_HOST_PAGES];
+	unsigned long address;
+	uint64_t start;
+	int next = 0, inflight = 0, i;
+
+	start = t->clock(t);
+	while ((next < blocks) || inflight) {
+		while ((next < blocks) && (inflight < depth)) {
+			usbaspTransfer_t* transfer = &transfers[next];
+			uint16_t length = plan[next].pages * USBASP_HOST_PAGESIZE;
+
+			address = (unsigned long) plan[next].page * USBASP_HOST_PAGESIZE;
+			memset(transfer, 0, sizeof(*transfer));
+			transfer->setup[0] = RQ_VENDOR_OUT;
+			transfer->setup[1] = USBASP_FUNC_WRITEFLASH_LONG;
+			transfer->setup[2] = address;
+			transfer->setup[3] = address >> 8;
+			transfer->setup[4] = address >> 16;
+			transfer->setup[5] = plan[next].flags;
+			transfer->setup[6] = length;
+			transfer->setup[7] = length >> 8;
+			transfer->data = &image.data[address];
+			transfer->done = planDone;
+			transfer->user = &inflight;
+			if (t->submit(t, transfer) < 0)
+				return 0;
+			inflight++;
+			next++;
+		}
+		if (t->events(t, 1000) < 0)
+			return 0;
+	}
+
+	for (i = 0; i < blocks; i++) {
+		if (transfers[i].result != plan[i].pages * USBASP_HOST_PAGESIZE)
+			return 0;
+	}
+	return t->clock(t) - start;
+}
+
+int main(int argc, char** argv) {
+	usbaspTransport_t* t;
+	uint64_t predicted, measured;
+	uint16_t block = USBASP_MAX_BLOCKSIZE;
+	int c, i, depth = 4, quiet = 0, r;
+
+	while ((c = getopt(argc, argv, "b:d:q")) != -1) {
+		switch (c) {
+		case 'b': block = strtoul(optarg, 0, 0) & ~(USBASP_HOST_PAGESIZE - 1); break;
+		case 'd': depth = atoi(optarg); break;
+		case 'q': quiet = 1; break;
+		default: usage();
+		}
+	}
+	if ((optind != argc - 1) || !block || (block > USBASP_MAX_BLOCKSIZE) || (depth < 1))
+		usage();
+
+	if (usbaspImageLoad(&image, argv[optind]) < 0) {
+		fprintf(stderr, "%s: can't read image\n", argv[optind]);
+		return 1;
+	}
+
+	planBuild(block / USBASP_HOST_PAGESIZE);
+	if (!quiet) {
+		for (i = 0; i < blocks; i++) {
+			printf("WRITEFLASH_LONG 0x%05lx %5u%s\n",
+					(unsigned long) plan[i].page * USBASP_HOST_PAGESIZE,
+					plan[i].pages * USBASP_HOST_PAGESIZE,
+					(plan[i].flags & PROG_BLOCKFLAG_SEQUENTIAL) ? " sequential" : "");
+		}
+	}
+
+	/* start from a blank part, as after the chip erase */
+	r = usbaspOpenSim(&t, 0x42);
+	if (r < 0) {
+		fprintf(stderr, "no simulated device\n");
+		return 1;
+	}
+	if (usbaspImageCheck(&image, t) < 0) {
+		fprintf(stderr, "%s: outside the writable window 0x%05lx-0x%05lx\n", argv[optind],
+				t->flashstart, t->flashend);
+		t->close(t);
+		return 1;
+	}
+	predicted = planPredict(depth);
+	measured = planRun(t, depth);
+	r = measured ? usbaspVerify(t, &image) : USBASP_HOST_EIO;
+	t->close(t);
+
+	printf("%d requests, predicted %.1f ms, measured %.1f ms, %s\n", blocks,
+			predicted / 1e6, measured / 1e6, (r == USBASP_HOST_OK) ? "verified" : "FAILED");
+	return (r == USBASP_HOST_OK) ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_avr_boot_h_included__
+#define __sim_avr_boot_h_included__
+
+#include "simhw.h"
+#include <avr/eeprom.h>
+
+#define GET_LOW_FUSE_BITS       0x0000
+#define GET_LOCK_BITS           0x0001
+#define GET_EXTENDED_FUSE_BITS  0x0002
+#define GET_HIGH_FUSE_BITS      0x0003
+
+#define boot_page_fill(address, data)   simSpm(SIM_SPM_FILL, (address), (data))
+#define boot_page_erase(address)        simSpm(SIM_SPM_ERASE, (address), 0)
+#define boot_page_write(address)        simSpm(SIM_SPM_WRITE, (address), 0)
+#define boot_rww_enable()               simSpm(SIM_SPM_RWWENABLE, 0, 0)
+#define boot_rww_enable_safe()          do { boot_spm_busy_wait(); eeprom_busy_wait(); boot_rww_enable(); } while (0)
+
+#define boot_spm_busy()                 simSpmBusy()
+#define boot_spm_busy_wait()            simSpmWait()
+#define boot_rww_busy()                 simRwwBusy()
+
+#define boot_signature_byte_get(address) simSignature(address)
+#define boot_lock_fuse_bits_get(address) simFuse(address)
+
+#endif
@@ -0,0 +1,60 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_avr_eeprom_h_included__
+#define __sim_avr_eeprom_h_included__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "simhw.h"
+
+#define EEADDR(p)   ((uint32_t)(uintptr_t)(p))
+
+#define eeprom_busy_wait()          simEepromWait()
+#define eeprom_is_ready()           (!simEepromBusy())
+
+#define eeprom_read_byte(p)         simEepromRead(EEADDR(p))
+#define eeprom_write_byte(p, v)     simEepromWrite(EEADDR(p), (v))
+#define eeprom_update_byte(p, v)    simEepromUpdate(EEADDR(p), (v))
+
+static inline uint16_t simEepromReadWord(uint32_t a) {
+	return simEepromRead(a) | (simEepromRead(a + 1) << 8);
+}
+
+static inline uint32_t simEepromReadDword(uint32_t a) {
+	return simEepromReadWord(a) | ((uint32_t) simEepromReadWord(a + 2) << 16);
+}
+
+static inline void simEepromUpdateBlock(const void* src, uint32_t a, size_t n) {
+	const uint8_t* s = src;
+
+	while (n--)
+		simEepromUpdate(a++, *s++);
+}
+
+static inline void simEepromReadBlock(void* dst, uint32_t a, size_t n) {
+	uint8_t* d = dst;
+
+	while (n--)
+		*d++ = simEepromRead(a++);
+}
+
+static inline void simEepromUpdateWord(uint32_t a, uint16_t v) {
+	simEepromUpdate(a, v);
+	simEepromUpdate(a + 1, v >> 8);
+}
+
+static inline void simEepromUpdateDword(uint32_t a, uint32_t v) {
+	simEepromUpdateWord(a, v);
+	simEepromUpdateWord(a + 2, v >> 16);
+}
+
+#define eeprom_read_word(p)             simEepromReadWord(EEADDR(p))
+#define eeprom_read_dword(p)            simEepromReadDword(EEADDR(p))
+#define eeprom_read_block(dst, p, n)    simEepromReadBlock((dst), EEADDR(p), (n))
+#define eeprom_update_word(p, v)        simEepromUpdateWord(EEADDR(p), (v))
+#define eeprom_update_dword(p, v)       simEepromUpdateDword(EEADDR(p), (v))
+#define eeprom_update_block(src, p, n)  simEepromUpdateBlock((src), EEADDR(p), (n))
+#define eeprom_write_word(p, v)         simEepromUpdateWord(EEADDR(p), (v))
+#define eeprom_write_dword(p, v)        simEepromUpdateDword(EEADDR(p), (v))
+#define eeprom_write_block(src, p, n)   simEepromUpdateBlock((src), EEADDR(p), (n))
+
+#endif
@@ -0,0 +1,11 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_avr_interrupt_h_included__
+#define __sim_avr_interrupt_h_included__
+
+#define cli()
+#define sei()
+
+/* the model calls the handler itself, see simuart.h */
+#define ISR(vector)     void vector(void)
+
+#endif
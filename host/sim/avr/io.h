@@ -0,0 +1,37 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_avr_io_h_included__
+#define __sim_avr_io_h_included__
+
+#include <stdint.h>
+#include "simhw.h"
+#include "simuart.h"
+
+#define SPM_PAGESIZE    256
+#define E2END           (SIM_EEPROM_SIZE - 1)
+#define FLASHEND        (SIM_FLASH_SIZE - 1)
+#define _VECTORS_SIZE   (4 * 35)
+
+#define _BV(bit)        (1 << (bit))
+
+#define PB7             7
+#define PC0             0
+#define PC1             1
+#define PD0             0
+
+/* UART0, see simuart.h */
+#define UDR0            simUdr0
+#define UCSR0A          (*simUartStatus())
+#define UCSR0B          simUcsr0b
+#define UCSR0C          simUcsr0c
+#define UBRR0           simUbrr0
+
+#define U2X0            1
+#define UCSZ00          1
+#define UCSZ01          2
+#define TXEN0           3
+#define RXEN0           4
+#define UDRE0           5
+#define RXC0            7
+#define RXCIE0          7
+
+#endif
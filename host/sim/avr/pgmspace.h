@@ -0,0 +1,18 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_avr_pgmspace_h_included__
+#define __sim_avr_pgmspace_h_included__
+
+#include <stdint.h>
+#include "simhw.h"
+
+#define PROGMEM
+
+/* byte reads take flash addresses and go to the simulated flash, tables
+ * declared PROGMEM by the sources stay in host memory and are only ever
+ * read as words through pgm_get_far_address() */
+#define pgm_read_byte_near(address)     simFlashRead(address)
+#define pgm_read_byte_far(address)      simFlashRead(address)
+#define pgm_get_far_address(var)        ((uintptr_t)&(var))
+#define pgm_read_dword_far(address)     (*(const uint32_t*)(uintptr_t)(address))
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * simdev.c - part of USBasp bootloader host tools
+ *
+ * Description....: The bootloader's engine as a simulated USB device
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+#include "simhw.h"
+#include "simdev.h"
+#include "engine.h"
+#include "usbasp.h"
+#include "usbdrv.h"
+#include "hid.h"
+
+#if !BOOT_CFG_HID
+#error "simdev.c models the BOOT_CFG_HID build"
+#endif
+
+static uint8_t sim_gone = 0;
+
+void simDeviceInit(uint32_t serial) {
+	simReset(serial);
+	engineInit();
+	sim_gone = 0;
+}
+
+void simDeviceRestart(void) {
+	engineInit();
+	sim_gone = 0;
+}
+
+void simDeviceIdle(uint64_t until) {
+	simStats_t before;
+	uint8_t rww;
+
+	while (simNow() < until) {
+		before = simStats;
+		rww = simRwwBusy();
+		engineTask();
+		simAdvance(SIM_LOOP_NS);
+
+		if (simSpmBusy()) {
+			simAdvanceTo((simSpmDone() < until) ? simSpmDone() : until);
+		} else if (!(engineStatus() & ENGINE_STATUS_ERASING) && (rww == simRwwBusy())
+				&& !memcmp(&before, &simStats, sizeof(before))) {
+			/* nothing left to do in the background */
+			simAdvanceTo(until);
+		}
+	}
+}
+
+/* the bus hands the device one packet, the device takes it once the last
+ * one has been dealt with */
+static void simPacket(uint64_t* bus) {
+	if (*bus < simNow())
+		*bus = simNow();
+	*bus += SIM_USB_PACKET_NS;
+	simDeviceIdle(*bus);
+	simAdvance(SIM_LOOP_NS);
+}
+
+/* the callbacks main.c passes a request to, by its type */
+static uint8_t simRead(uint8_t hid, uint8_t* data, uint8_t len) {
+	return hid ? hidRead(data, len) : engineRead(data, len);
+}
+
+static uint8_t simWrite(uint8_t hid, uint8_t* data, uint8_t len) {
+	return hid ? hidWrite(data, len) : engineFeed(data, len);
+}
+
+/* what usbFunctionSetup() and V-USB do with a vendor request, or with a
+ * class request of the HID build's feature reports */
+int simDeviceControl(const uint8_t* setup, uint8_t* data, uint64_t start, uint64_t* done) {
+	usbRequest_t* rq = (void*)setup;
+	uint16_t wLength = rq->wLength.word;
+	uint16_t pos = 0, len, stream;
+	uint8_t chunk, got, request[8];
+	uint8_t* reply = 0;
+	uint8_t type = rq->bmRequestType & USBRQ_TYPE_MASK;
+	uint8_t hid = (type == USBRQ_TYPE_CLASS);
+	int result = 0;
+
+	uint64_t bus = start;
+
+	memcpy(request, setup, sizeof(request));
+	simPacket(&bus);
+
+	if (sim_gone || ((type != USBRQ_TYPE_VENDOR) && !hid)) {
+		/* standard requests are answered by the gadget or the OS, not here */
+		result = SIM_STALL;
+		wLength = 0;
+	} else {
+		if (hid) {
+			len = hidSetup((void*)request);
+			stream = USB_NO_MSG;
+		} else {
+			len = engineSetup(request, &reply);
+			stream = ENGINE_STREAM;
+		}
+
+		if (rq->bmRequestType & USBRQ_DIR_DEVICE_TO_HOST) {
+			if (len != stream) {
+				if (len > wLength)
+					len = wLength;
+				memcpy(data, reply, len);
+				for (pos = 0; pos < len; pos += 8) {
+					simPacket(&bus);
+				}
+				pos = len;
+			} else {
+				while (pos < wLength) {
+					chunk = (wLength - pos > 8) ? 8 : wLength - pos;
+					simPacket(&bus);
+					got = simRead(hid, &data[pos], chunk);
+					if (got > chunk) {
+						result = SIM_STALL;
+						break;
+					}
+					pos += got;
+					if (got < chunk)
+						break;
+				}
+			}
+		} else {
+			/* V-USB hands every data packet to usbFunctionWrite(), even after
+			 * it returned 1 */
+			while (pos < wLength) {
+				chunk = (wLength - pos > 8) ? 8 : wLength - pos;
+				simPacket(&bus);
+				if ((len == stream) && (simWrite(hid, &data[pos], chunk) == 0xff))
+					result = SIM_STALL;
+				pos += chunk;
+			}
+		}
+	}
+
+	/* status stage */
+	simPacket(&bus);
+	*done = bus;
+
+	if (engineStatus() & ENGINE_STATUS_FINISHED) {
+		engineEnd();
+		sim_gone = 1;
+	}
+
+	return (result == SIM_STALL) ? SIM_STALL : pos;
+}
+
+uint8_t simDeviceGone(void) {
+	return sim_gone;
+}
+
+uint8_t simDeviceLoad(const char* path) {
+	FILE* f = fopen(path, "rb");
+	uint8_t ok;
+
+	if (!f)
+		return 0;
+	ok = (fread(simFlash, 1, sizeof(simFlash), f) == sizeof(simFlash))
+			&& (fread(simEeprom, 1, sizeof(simEeprom), f) == sizeof(simEeprom));
+	fclose(f);
+	return ok;
+}
+
+uint8_t simDeviceSave(const char* path) {
+	FILE* f = fopen(path, "wb");
+	uint8_t ok;
+
+	if (!f)
+		return 0;
+	ok = (fwrite(simFlash, 1, sizeof(simFlash), f) == sizeof(simFlash))
+			&& (fwrite(simEeprom, 1, sizeof(simEeprom), f) == sizeof(simEeprom));
+	return (fclose(f) == 0) && ok;
+}
+
+static void simDeviceServe(int fd) {
+	static simMessage_t msg;
+	ssize_t n;
+	uint64_t done;
+
+	while ((n = recv(fd, &msg, sizeof(msg), 0)) >= (ssize_t) SIM_MESSAGE_HEADER) {
+		msg.result = simDeviceControl(msg.setup, msg.data, msg.time, &done);
+		msg.time = done;
+		n = SIM_MESSAGE_HEADER;
+		if ((msg.setup[0] & USBRQ_DIR_DEVICE_TO_HOST) && (msg.result > 0))
+			n += msg.result;
+		if (send(fd, &msg, n, 0) != n)
+			break;
+
+		/* the application has taken over, the bootloader is gone */
+		if (sim_gone)
+			break;
+	}
+}
+
+int simDeviceSpawn(uint32_t serial, pid_t* pid) {
+	int fds[2], fd;
+	int size = sizeof(simMessage_t) + 256;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0)
+		return -1;
+	setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+	*pid = fork();
+	if (*pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+
+	if (*pid == 0) {
+		/* sockets of devices spawned earlier would otherwise stay open
+		 * here and those devices never see their host go away */
+		for (fd = sysconf(_SC_OPEN_MAX) - 1; fd > 2; fd--) {
+			if (fd != fds[1])
+				close(fd);
+		}
+		signal(SIGINT, SIG_IGN);
+		simDeviceInit(serial);
+		simDeviceServe(fds[1]);
+		if (simStats.violations)
+			fprintf(stderr, "simdev %08lx: %lu hardware rule violations\n",
+					(unsigned long) serial, (unsigned long) simStats.violations);
+		_exit(simStats.violations ? 1 : 0);
+	}
+
+	close(fds[1]);
+	return fds[0];
+}
@@ -0,0 +1,71 @@
+/*
+ * simdev.h - part of USBasp bootloader host tools
+ *
+ * Description....: The bootloader's engine as a simulated USB device
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __simdev_h_included__
+#define __simdev_h_included__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Bus timing of the low speed V-USB device. Every control transfer is a
+ * setup packet, its 8 byte data packets and a status packet, each taking
+ * SIM_USB_PACKET_NS. That is about four transactions per 1ms frame, what a
+ * low speed device behind a hub gets in practice. A host waiting for one
+ * transfer before it submits the next loses SIM_USB_TURNAROUND_NS, the
+ * frame it takes to see the completion. */
+#define SIM_USB_PACKET_NS       250000ULL
+#define SIM_USB_TURNAROUND_NS   1000000ULL
+
+/* cost of one pass through the main loop or a V-USB callback */
+#define SIM_LOOP_NS             20000ULL
+
+/* result of a control transfer that the device stalled */
+#define SIM_STALL               (-1)
+
+/* blank the simulated part and start the engine, serial goes into the
+ * signature row and from there into the USB serial number */
+void simDeviceInit(uint32_t serial);
+
+/* start the bootloader again on the part as it is, after simDeviceLoad() */
+void simDeviceRestart(void);
+
+/* run the main loop (background erase, erase-ahead) until the bus time */
+void simDeviceIdle(uint64_t until);
+
+/* run one control transfer that the host starts at the bus time start.
+ * data holds the OUT data stage or receives the IN data stage, both up to
+ * wLength bytes. Returns the number of bytes of the data stage or SIM_STALL,
+ * *done is the bus time of the status stage */
+int simDeviceControl(const uint8_t* setup, uint8_t* data, uint64_t start, uint64_t* done);
+
+/* the host sent DISCONNECT, the bootloader has launched the application */
+uint8_t simDeviceGone(void);
+
+/* load and store flash and EEPROM so a device keeps its content between
+ * runs, returns 0 on failure */
+uint8_t simDeviceLoad(const char* path);
+uint8_t simDeviceSave(const char* path);
+
+/* Run a simulated device in a child process, one per device since the
+ * engine keeps its state in static variables. Returns a SOCK_SEQPACKET
+ * socket carrying simMessage_t requests and replies, or -1 */
+int simDeviceSpawn(uint32_t serial, pid_t* pid);
+
+#define SIM_MESSAGE_MAXDATA     0x8000
+
+typedef struct {
+	uint64_t time;          /* request: bus start time, reply: status stage */
+	int32_t result;         /* reply: simDeviceControl() result */
+	uint8_t setup[8];
+	uint8_t data[SIM_MESSAGE_MAXDATA];
+} simMessage_t;
+
+#define SIM_MESSAGE_HEADER      (sizeof(simMessage_t) - SIM_MESSAGE_MAXDATA)
+
+#endif /* __simdev_h_included__ */
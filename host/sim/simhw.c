@@ -0,0 +1,184 @@
+/*
+ * simhw.c - part of USBasp bootloader host tools
+ *
+ * Description....: Simulated ATmega1284P flash, EEPROM and spm unit
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "simhw.h"
+
+#define SIM_PAGESIZE    256
+
+uint8_t simFlash[SIM_FLASH_SIZE];
+uint8_t simEeprom[SIM_EEPROM_SIZE];
+simStats_t simStats;
+
+volatile uint8_t SREG, PORTB, PORTC, PORTD, DDRB, DDRC;
+
+static uint64_t sim_now;
+static uint64_t spm_done;
+static uint64_t eeprom_done;
+static uint8_t rww_busy;
+static uint8_t page_buffer[SIM_PAGESIZE];
+static uint8_t signature[0x20];
+
+static const uint8_t fuses[4] = {
+	0xff,   /* low, full swing crystal */
+	0xff,   /* lock, nothing locked */
+	0xff,   /* extended */
+	0x98,   /* high, 8k boot section, BOOTRST */
+};
+
+static void simViolation(const char* what, uint32_t address) {
+	simStats.violations++;
+	fprintf(stderr, "simhw: %s at 0x%05lx\n", what, (unsigned long) address);
+}
+
+void simReset(uint32_t serial) {
+	uint8_t i;
+
+	memset(simFlash, 0xff, sizeof(simFlash));
+	memset(simEeprom, 0xff, sizeof(simEeprom));
+	memset(page_buffer, 0xff, sizeof(page_buffer));
+	memset(&simStats, 0, sizeof(simStats));
+	sim_now = spm_done = eeprom_done = 0;
+	rww_busy = 0;
+
+	/* 1e 97 05 with the calibration byte in between, then the wafer
+	 * position bytes the serial number is made of */
+	memset(signature, 0xff, sizeof(signature));
+	signature[0x00] = 0x1e;
+	signature[0x01] = 0x9a;
+	signature[0x02] = 0x97;
+	signature[0x04] = 0x05;
+	for (i = 0; i < 10; i++) {
+		signature[0x0e + i] = (i < 4) ? (serial >> (8 * i)) : (0x30 + i);
+	}
+}
+
+uint64_t simNow(void) {
+	return sim_now;
+}
+
+void simAdvance(uint64_t ns) {
+	sim_now += ns;
+}
+
+void simAdvanceTo(uint64_t ns) {
+	if (ns > sim_now)
+		sim_now = ns;
+}
+
+uint8_t simSpmBusy(void) {
+	return sim_now < spm_done;
+}
+
+uint64_t simSpmDone(void) {
+	return spm_done;
+}
+
+void simSpmWait(void) {
+	simAdvanceTo(spm_done);
+}
+
+uint8_t simRwwBusy(void) {
+	return rww_busy;
+}
+
+void simSpm(uint8_t op, uint32_t address, uint16_t word) {
+	uint32_t page = address & ~(SIM_PAGESIZE - 1UL);
+	uint16_t i;
+
+	if (simSpmBusy()) {
+		simViolation("spm while the last one is running", address);
+		return;
+	}
+	if ((op != SIM_SPM_FILL) && simEepromBusy()) {
+		simViolation("spm during an EEPROM write", address);
+		return;
+	}
+
+	switch (op) {
+	case SIM_SPM_FILL:
+		page_buffer[address & (SIM_PAGESIZE - 2)] = word;
+		page_buffer[(address & (SIM_PAGESIZE - 2)) + 1] = word >> 8;
+		break;
+	case SIM_SPM_ERASE:
+	case SIM_SPM_WRITE:
+		if ((page >= SIM_NRWW_START) || (page >= SIM_FLASH_SIZE)) {
+			simViolation("spm on the boot section", address);
+			return;
+		}
+		if (op == SIM_SPM_ERASE) {
+			memset(&simFlash[page], 0xff, SIM_PAGESIZE);
+			simStats.erases++;
+			spm_done = sim_now + SIM_SPM_ERASE_NS;
+		} else {
+			/* programming only ever clears bits */
+			for (i = 0; i < SIM_PAGESIZE; i++) {
+				simFlash[page + i] &= page_buffer[i];
+			}
+			memset(page_buffer, 0xff, sizeof(page_buffer));
+			simStats.writes++;
+			spm_done = sim_now + SIM_SPM_WRITE_NS;
+		}
+		rww_busy = 1;
+		break;
+	case SIM_SPM_RWWENABLE:
+		rww_busy = 0;
+		break;
+	}
+}
+
+uint8_t simFlashRead(uint32_t address) {
+	simAdvance(SIM_READ_NS);
+	if (address >= SIM_FLASH_SIZE)
+		return 0xff;
+	if ((address < SIM_NRWW_START) && rww_busy) {
+		simViolation("read of the busy RWW section", address);
+		return 0xff;
+	}
+	return simFlash[address];
+}
+
+uint8_t simEepromBusy(void) {
+	return sim_now < eeprom_done;
+}
+
+void simEepromWait(void) {
+	simAdvanceTo(eeprom_done);
+}
+
+uint8_t simEepromRead(uint32_t address) {
+	simEepromWait();
+	return simEeprom[address % SIM_EEPROM_SIZE];
+}
+
+void simEepromWrite(uint32_t address, uint8_t value) {
+	simEepromWait();
+	if (simSpmBusy()) {
+		simViolation("EEPROM write during spm", address);
+		return;
+	}
+	simEeprom[address % SIM_EEPROM_SIZE] = value;
+	simStats.eepromwrites++;
+	eeprom_done = sim_now + SIM_EEPROM_NS;
+}
+
+void simEepromUpdate(uint32_t address, uint8_t value) {
+	if (simEepromRead(address) != value)
+		simEepromWrite(address, value);
+}
+
+uint8_t simSignature(uint8_t address) {
+	return signature[address % sizeof(signature)];
+}
+
+uint8_t simFuse(uint8_t address) {
+	return fuses[address & 3];
+}
@@ -0,0 +1,74 @@
+/*
+ * simhw.h - part of USBasp bootloader host tools
+ *
+ * Description....: Simulated ATmega1284P flash, EEPROM and spm unit
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __simhw_h_included__
+#define __simhw_h_included__
+
+#include <stdint.h>
+
+/* The avr/ headers next to this file map the avr-libc calls used by the
+ * bootloader's engine.c, flash.c and journal.c onto this model, so the very
+ * same sources run on the host. Time only moves when the model says so: spm
+ * and EEPROM operations complete after the datasheet's worst case delays and
+ * every flash read costs a few cycles. */
+
+#define SIM_FLASH_SIZE      0x20000UL
+#define SIM_EEPROM_SIZE     4096
+#define SIM_NRWW_START      0x1E000UL   /* the boot section, readable during spm */
+
+#define SIM_SPM_ERASE_NS    4500000ULL  /* tWD_FLASH */
+#define SIM_SPM_WRITE_NS    4500000ULL
+#define SIM_EEPROM_NS       3400000ULL  /* tWD_EEPROM, erase and write */
+#define SIM_READ_NS         500ULL      /* a flash read and its loop, ~6 cycles */
+
+/* spm operations, as avr/boot.h would write them to SPMCSR */
+#define SIM_SPM_FILL        0
+#define SIM_SPM_ERASE       1
+#define SIM_SPM_WRITE       2
+#define SIM_SPM_RWWENABLE   3
+
+typedef struct {
+	uint32_t erases;
+	uint32_t writes;
+	uint32_t eepromwrites;
+	uint32_t violations;    /* accesses the real part would get wrong */
+} simStats_t;
+
+extern uint8_t simFlash[SIM_FLASH_SIZE];
+extern uint8_t simEeprom[SIM_EEPROM_SIZE];
+extern simStats_t simStats;
+
+/* registers the sources touch, they have no effect */
+extern volatile uint8_t SREG, PORTB, PORTC, PORTD, DDRB, DDRC;
+
+/* blank flash and EEPROM, the serial number ends up in the signature row */
+void simReset(uint32_t serial);
+
+uint64_t simNow(void);
+void simAdvance(uint64_t ns);
+void simAdvanceTo(uint64_t ns);
+
+void simSpm(uint8_t op, uint32_t address, uint16_t word);
+uint8_t simSpmBusy(void);
+uint64_t simSpmDone(void);
+void simSpmWait(void);
+uint8_t simRwwBusy(void);
+
+uint8_t simFlashRead(uint32_t address);
+
+uint8_t simEepromRead(uint32_t address);
+void simEepromWrite(uint32_t address, uint8_t value);
+void simEepromUpdate(uint32_t address, uint8_t value);
+uint8_t simEepromBusy(void);
+void simEepromWait(void);
+
+uint8_t simSignature(uint8_t address);
+uint8_t simFuse(uint8_t address);
+
+#endif /* __simhw_h_included__ */
@@ -0,0 +1,182 @@
+/*
+ * simuart.c - part of USBasp bootloader host tools
+ *
+ * Description....: The bootloader's UART link on a pseudo terminal
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <avr/io.h>
+
+#include "simhw.h"
+#include "simdev.h"
+#include "simuart.h"
+#include "engine.h"
+#include "uartlink.h"
+#include "usbasp.h"
+
+#if BOOT_CFG_UART != 2
+#error "simuart.c needs BOOT_CFG_UART == 2"
+#endif
+
+volatile uint16_t simUdr0 = SIM_UART_EMPTY;
+volatile uint8_t simUcsr0b, simUcsr0c;
+volatile uint16_t simUbrr0;
+
+/* frames are followed through their length, so whole frames get lost */
+typedef struct {
+	uint8_t header[USBASP_UART_HEADERLEN];
+	uint16_t pos;
+	uint16_t len;           /* 0 while waiting for SOF */
+	unsigned count;
+	uint8_t drop;
+} simLine_t;
+
+static int uart_fd;
+static unsigned uart_drop;
+static simLine_t uart_rx, uart_tx;
+static uint8_t uart_out[1024];
+static size_t uart_outlen;
+static volatile uint8_t uart_status;
+
+/* returns 0 if the byte gets lost */
+static uint8_t simLineKeep(simLine_t* line, uint8_t c) {
+	if (line->len == 0) {
+		if (c != USBASP_UART_SOF)
+			return 1;
+		line->pos = 0;
+		line->len = USBASP_UART_HEADERLEN;
+		line->drop = uart_drop && (++line->count % uart_drop == 0);
+	}
+
+	if (line->pos < USBASP_UART_HEADERLEN)
+		line->header[line->pos] = c;
+	if (++line->pos == USBASP_UART_HEADERLEN)
+		line->len += (line->header[3] | (line->header[4] << 8)) + 2;
+	if (line->pos == line->len)
+		line->len = 0;
+	return !line->drop;
+}
+
+static void simUartFlush(void) {
+	size_t n = 0;
+	ssize_t r;
+
+	while (n < uart_outlen) {
+		r = write(uart_fd, &uart_out[n], uart_outlen - n);
+		if (r <= 0)
+			break;
+		n += r;
+	}
+	uart_outlen = 0;
+}
+
+volatile uint8_t* simUartStatus(void) {
+	if (simUdr0 != SIM_UART_EMPTY) {
+		if (simLineKeep(&uart_tx, simUdr0))
+			uart_out[uart_outlen++] = simUdr0;
+		simUdr0 = SIM_UART_EMPTY;
+		if (uart_outlen == sizeof(uart_out))
+			simUartFlush();
+	}
+	uart_status = (simUcsr0b & _BV(TXEN0)) ? _BV(UDRE0) : 0;
+	return &uart_status;
+}
+
+void simUartServe(int fd, unsigned drop) {
+	struct pollfd p = { fd, POLLIN, 0 };
+	uint8_t buffer[256];
+	ssize_t n, i;
+
+	uart_fd = fd;
+	uart_drop = drop;
+	memset(&uart_rx, 0, sizeof(uart_rx));
+	memset(&uart_tx, 0, sizeof(uart_tx));
+	uartLinkInit();
+
+	for (;;) {
+		/* the last byte written waits in UDR0 */
+		simUartStatus();
+		simUartFlush();
+
+		/* less than the receive ring holds between two polls */
+		if (poll(&p, 1, 1) < 0)
+			break;
+		if (p.revents & POLLIN) {
+			n = read(fd, buffer, sizeof(buffer));
+			if (n <= 0)
+				break;
+			for (i = 0; i < n; i++) {
+				if (!simLineKeep(&uart_rx, buffer[i]))
+					continue;
+				simUdr0 = buffer[i];
+				if (simUcsr0b & _BV(RXCIE0))
+					USART0_RX_vect();
+				simUdr0 = SIM_UART_EMPTY;
+			}
+		} else if (p.revents & (POLLHUP | POLLERR)) {
+			break;
+		}
+
+		uartLinkPoll();
+		engineTask();
+		simAdvance(SIM_LOOP_NS);
+
+		if (engineStatus() & ENGINE_STATUS_FINISHED) {
+			engineEnd();
+			simUartStatus();
+			simUartFlush();
+			break;
+		}
+	}
+}
+
+int simUartSpawn(uint32_t serial, unsigned drop, char* path, size_t size, pid_t* pid) {
+	int master, slave, fd;
+	char* name;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0)
+		return -1;
+	name = (grantpt(master) == 0) && (unlockpt(master) == 0) ? ptsname(master) : 0;
+	slave = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+	if (slave < 0) {
+		close(master);
+		return -1;
+	}
+	snprintf(path, size, "%s", name);
+
+	*pid = fork();
+	if (*pid < 0) {
+		close(master);
+		close(slave);
+		return -1;
+	}
+
+	if (*pid == 0) {
+		for (fd = sysconf(_SC_OPEN_MAX) - 1; fd > 2; fd--) {
+			if (fd != master)
+				close(fd);
+		}
+		signal(SIGINT, SIG_IGN);
+		simDeviceInit(serial);
+		simUartServe(master, drop);
+		if (simStats.violations)
+			fprintf(stderr, "simuart %08lx: %lu hardware rule violations\n",
+					(unsigned long) serial, (unsigned long) simStats.violations);
+		_exit(simStats.violations ? 1 : 0);
+	}
+
+	close(master);
+	return slave;
+}
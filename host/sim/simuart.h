@@ -0,0 +1,41 @@
+/*
+ * simuart.h - part of USBasp bootloader host tools
+ *
+ * Description....: The bootloader's UART link on a pseudo terminal
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __simuart_h_included__
+#define __simuart_h_included__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* uartlink.c built with BOOT_CFG_UART == 2 drives these registers through
+ * avr/io.h. A byte written to UDR0 goes out when the transmitter is asked
+ * for UDRE0 again, received bytes are put into UDR0 and handed to the
+ * receive interrupt between passes through the main loop. Listening for
+ * the first frame with RXC0 (BOOT_CFG_UART == 1) isn't modelled. */
+#define SIM_UART_EMPTY      0x100       /* UDR0 holds nothing to send */
+
+extern volatile uint16_t simUdr0;
+extern volatile uint8_t simUcsr0b, simUcsr0c;
+extern volatile uint16_t simUbrr0;
+
+volatile uint8_t* simUartStatus(void);
+void USART0_RX_vect(void);
+
+/* Run the bootloader with the UART link on fd until the host side closes
+ * or the application is started. Every drop-th frame in either direction
+ * gets lost on the line, 0 keeps them all */
+void simUartServe(int fd, unsigned drop);
+
+/* Run a simulated device in a child process on a new pseudo terminal, its
+ * name goes to path. Returns a descriptor of the terminal side that keeps
+ * the device running until it is closed, or -1 */
+int simUartSpawn(uint32_t serial, unsigned drop, char* path, size_t size, pid_t* pid);
+
+#endif /* __simuart_h_included__ */
@@ -0,0 +1,45 @@
+/* host stand-in for V-USB's usbdrv.h, see simhw.h. The driver declares
+ * usbWord_t with an unsigned int, which is two bytes only on the AVR, so the
+ * engine gets the request layout from here */
+#ifndef __usbdrv_h_included__
+#define __usbdrv_h_included__
+
+#include <stdint.h>
+
+typedef uint8_t uchar;
+
+/* the bootloader is built with USB_CFG_LONG_TRANSFERS */
+typedef uint16_t usbMsgLen_t;
+#define USB_NO_MSG                  ((usbMsgLen_t)-1)
+
+typedef union usbWord {
+	uint16_t word;
+	uchar bytes[2];
+} usbWord_t;
+
+typedef struct usbRequest {
+	uchar bmRequestType;
+	uchar bRequest;
+	usbWord_t wValue;
+	usbWord_t wIndex;
+	usbWord_t wLength;
+} usbRequest_t;
+
+#define USBRQ_RCPT_MASK             0x1f
+#define USBRQ_RCPT_DEVICE           0
+#define USBRQ_RCPT_INTERFACE        1
+#define USBRQ_RCPT_ENDPOINT         2
+
+#define USBRQ_TYPE_MASK             0x60
+#define USBRQ_TYPE_STANDARD         (0<<5)
+#define USBRQ_TYPE_CLASS            (1<<5)
+#define USBRQ_TYPE_VENDOR           (2<<5)
+
+#define USBRQ_DIR_MASK              0x80
+#define USBRQ_DIR_HOST_TO_DEVICE    (0<<7)
+#define USBRQ_DIR_DEVICE_TO_HOST    (1<<7)
+
+#define USBRQ_HID_GET_REPORT        0x01
+#define USBRQ_HID_SET_REPORT        0x09
+
+#endif /* __usbdrv_h_included__ */
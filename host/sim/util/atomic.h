@@ -0,0 +1,9 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_util_atomic_h_included__
+#define __sim_util_atomic_h_included__
+
+/* interrupts only run between main loop passes in the model */
+#define ATOMIC_RESTORESTATE     0
+#define ATOMIC_BLOCK(type)      for (int __done = 1; __done; __done = 0)
+
+#endif
@@ -0,0 +1,14 @@
+/* host stand-in for avr-libc, see simhw.h */
+#ifndef __sim_util_crc16_h_included__
+#define __sim_util_crc16_h_included__
+
+#include <stdint.h>
+
+/* avr-libc's C equivalent of its assembler version */
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+	data ^= crc & 0xff;
+	data ^= data << 4;
+	return (((uint16_t) data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t) data << 3);
+}
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * test.c - part of USBasp bootloader host tools
+ *
+ * Description....: Regression tests against the simulated device
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "usbasphost.h"
+#include "flash.h"
+#include "services.h"
+#include "sim/simhw.h"
+#include "sim/simdev.h"
+#include "sim/simuart.h"
+
+/* what the service table jumps to, services.h only has the table calls */
+uint8_t servicePageErase(uint32_t address);
+uint8_t servicePageFill(uint32_t address, uint16_t word);
+uint8_t servicePageWrite(uint32_t address);
+uint8_t servicePageProgram(uint32_t address, const uint8_t* data);
+
+/* the host library's default write request */
+#define TEST_BLOCKSIZE  2048
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		printf("  FAILED line %d: ", __LINE__); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+		failures++; \
+	} \
+} while (0)
+
+static void pattern(uint8_t* data, unsigned long length, unsigned long seed) {
+	unsigned long i;
+
+	for (i = 0; i < length; i++) {
+		data[i] = (seed + i * 7) ^ (i >> 8);
+	}
+}
+
+/* Addresses with bit 15 or bits 16..23 set. On the AVR an int is 16 bits,
+ * so an address byte shifted without a cast turns into a negative int and
+ * sign-extends into the high word. The host's 32 bit int can't show that,
+ * so this pins down where the data has to land for the AVR build. */
+static const unsigned long highAddresses[] = { 0x08000, 0x0ff00, 0x18000, 0x1df00 };
+
+static void testLongAddress(usbaspTransport_t* t) {
+	uint8_t data[USBASP_HOST_PAGESIZE], back[USBASP_HOST_PAGESIZE];
+	unsigned long address;
+	uint32_t crc;
+	unsigned i;
+	int r;
+
+	for (i = 0; i < sizeof(highAddresses) / sizeof(highAddresses[0]); i++) {
+		address = highAddresses[i];
+		pattern(data, sizeof(data), address);
+		r = usbaspControl(t, USBASP_FUNC_WRITEFLASH_LONG, address, address >> 16,
+				data, sizeof(data), 0);
+		CHECK(r == sizeof(data), "WRITEFLASH_LONG 0x%05lx returned %d", address, r);
+
+		memset(back, 0, sizeof(back));
+		r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, address, address >> 16,
+				back, sizeof(back), 1);
+		CHECK((r == sizeof(back)) && !memcmp(data, back, sizeof(data)),
+				"READFLASH_LONG 0x%05lx doesn't return what was written", address);
+
+		r = usbaspCrc32(t, address / USBASP_HOST_PAGESIZE, 1, &crc);
+		CHECK((r == USBASP_HOST_OK) && (crc == usbaspHostCrc32(0, data, sizeof(data))),
+				"page 0x%05lx has the wrong CRC-32", address);
+	}
+}
+
+static void sgRecord(uint8_t* record, unsigned long address, uint16_t length) {
+	record[0] = address;
+	record[1] = address >> 8;
+	record[2] = address >> 16;
+	record[3] = length;
+	record[4] = length >> 8;
+}
+
+/* scatter-gather records whose middle address byte is 0x80 and up */
+static void testScatterGather(usbaspTransport_t* t) {
+	static const struct {
+		unsigned long address;
+		uint16_t length;
+	} ranges[] = { { 0x08010, 40 }, { 0x0fff0, 32 }, { 0x1a0f0, 48 } };
+	uint8_t request[256], list[sizeof(ranges) / sizeof(ranges[0]) * USBASP_SG_RECORDSIZE];
+	uint8_t data[128], back[128];
+	uint16_t length = 0, total = 0;
+	unsigned i;
+	int r;
+
+	for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+		sgRecord(&request[length], ranges[i].address, ranges[i].length);
+		sgRecord(&list[i * USBASP_SG_RECORDSIZE], ranges[i].address, ranges[i].length);
+		length += USBASP_SG_RECORDSIZE;
+		pattern(&request[length], ranges[i].length, ranges[i].address);
+		memcpy(&data[total], &request[length], ranges[i].length);
+		length += ranges[i].length;
+		total += ranges[i].length;
+	}
+
+	r = usbaspControl(t, USBASP_FUNC_WRITEFLASH_SG, 0, 0, request, length, 0);
+	CHECK(r == length, "WRITEFLASH_SG returned %d", r);
+
+	for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+		r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, ranges[i].address,
+				ranges[i].address >> 16, back, ranges[i].length, 1);
+		pattern(request, ranges[i].length, ranges[i].address);
+		CHECK((r == ranges[i].length) && !memcmp(request, back, ranges[i].length),
+				"WRITEFLASH_SG didn't land at 0x%05lx", ranges[i].address);
+	}
+
+	r = usbaspControl(t, USBASP_FUNC_SETREADLIST, 0, 0, list, sizeof(list), 0);
+	CHECK(r == sizeof(list), "SETREADLIST returned %d", r);
+	memset(back, 0, sizeof(back));
+	r = usbaspControl(t, USBASP_FUNC_READFLASH_SG, 0, 0, back, total, 1);
+	CHECK((r == total) && !memcmp(data, back, total), "READFLASH_SG returned the wrong bytes");
+}
+
+/* READFLASH_RLE addressed through wValue at 0x8000, with runs, literals
+ * and escape bytes, then the whole page through usbaspReadRle() */
+static void testRle(usbaspTransport_t* t) {
+	uint8_t data[USBASP_HOST_PAGESIZE], reply[2 * USBASP_HOST_PAGESIZE], back[USBASP_HOST_PAGESIZE];
+	const unsigned long address = 0x08000;
+	long decoded;
+	int r;
+
+	pattern(data, sizeof(data), address);
+	memset(&data[16], 0x00, 40);
+	memset(&data[100], USBASP_RLE_ESCAPE, 2);
+	data[120] = USBASP_RLE_ESCAPE;
+	memset(&data[200], 0xff, 56);
+	r = usbaspControl(t, USBASP_FUNC_WRITEFLASH_LONG, address, address >> 16,
+			data, sizeof(data), 0);
+	CHECK(r == sizeof(data), "WRITEFLASH_LONG returned %d", r);
+
+	r = usbaspControl(t, USBASP_FUNC_READFLASH_RLE, address, sizeof(data),
+			reply, sizeof(reply), 1);
+	CHECK((r > 0) && (r < (int) sizeof(data)), "READFLASH_RLE returned %d", r);
+	decoded = usbaspRleDecode(reply, (r > 0) ? r : 0, back, sizeof(back));
+	CHECK((decoded == sizeof(data)) && !memcmp(data, back, sizeof(data)),
+			"READFLASH_RLE at 0x%05lx decodes to the wrong bytes", address);
+
+	/* small replies make the host continue after partial pages */
+	memset(back, 0, sizeof(back));
+	r = usbaspReadRle(t, address, back, sizeof(back), 16);
+	CHECK((r == USBASP_HOST_OK) && !memcmp(data, back, sizeof(data)),
+			"usbaspReadRle in 16 byte replies returned the wrong bytes");
+}
+
+/* a vendor request to the device in this process */
+static int simControl(uint8_t request, uint16_t value, uint16_t index,
+		uint8_t* data, uint16_t length, uint8_t in) {
+	uint8_t setup[8] = { in ? 0xc0 : 0x40, request, value, value >> 8, index, index >> 8,
+			length, length >> 8 };
+	uint64_t done;
+
+	return simDeviceControl(setup, data, simNow(), &done);
+}
+
+static uint16_t fingerprintGet(void) {
+	usbaspFingerprint_t record;
+	int r;
+
+	r = simControl(USBASP_FUNC_GETFINGERPRINT, 0, 0, (uint8_t*)&record, sizeof(record), 1);
+	CHECK(r == sizeof(record), "GETFINGERPRINT returned %d", r);
+	return record.pages;
+}
+
+/* store a fingerprint over the first two pages, returns its page count as
+ * GETFINGERPRINT reports it */
+static uint16_t fingerprintSet(void) {
+	uint8_t buildid[USBASP_BUILDID_LEN] = "services";
+	int r;
+
+	r = simControl(USBASP_FUNC_SETFINGERPRINT, 2, 0, buildid, sizeof(buildid), 0);
+	CHECK(r == sizeof(buildid), "SETFINGERPRINT returned %d", r);
+	return fingerprintGet();
+}
+
+/* The application's flash writes through the service table have to clear
+ * the fingerprint, refused ones must leave it alone. The services are
+ * called directly, so the device runs in this process rather than behind
+ * the transport. */
+static void testServices(usbaspTransport_t* t) {
+	uint8_t page[USBASP_HOST_PAGESIZE];
+	uint16_t i;
+
+	(void) t;
+	simDeviceInit(0x42);
+	pattern(page, sizeof(page), 0x100);
+
+	CHECK(fingerprintSet() == 2, "fingerprint not stored");
+	CHECK(servicePageErase(FLASH_BOOT_START) == BOOT_SERVICE_REFUSED, "boot section erase not refused");
+	CHECK(servicePageProgram(FLASH_BOOT_START, page) == BOOT_SERVICE_REFUSED,
+			"boot section write not refused");
+	CHECK(fingerprintGet() == 2, "a refused service cleared the fingerprint");
+
+	CHECK(servicePageProgram(0x100, page) == BOOT_SERVICE_OK, "servicePageProgram failed");
+	CHECK(fingerprintGet() == USBASP_FINGERPRINT_NONE, "servicePageProgram left the fingerprint");
+	CHECK(!memcmp(&simFlash[0x100], page, sizeof(page)), "servicePageProgram didn't write the page");
+
+	CHECK(fingerprintSet() == 2, "fingerprint not stored");
+	CHECK(servicePageErase(0x100) == BOOT_SERVICE_OK, "servicePageErase failed");
+	CHECK(fingerprintGet() == USBASP_FINGERPRINT_NONE, "servicePageErase left the fingerprint");
+
+	CHECK(fingerprintSet() == 2, "fingerprint not stored");
+	for (i = 0; i < sizeof(page); i += 2) {
+		servicePageFill(0x100 + i, page[i] | (page[i + 1] << 8));
+	}
+	CHECK(fingerprintGet() == 2, "servicePageFill cleared the fingerprint");
+	CHECK(servicePageWrite(0x100) == BOOT_SERVICE_OK, "servicePageWrite failed");
+	CHECK(fingerprintGet() == USBASP_FINGERPRINT_NONE, "servicePageWrite left the fingerprint");
+	CHECK(!memcmp(&simFlash[0x100], page, sizeof(page)), "servicePageWrite didn't write the page");
+
+	CHECK(simStats.violations == 0, "%lu hardware rule violations", (unsigned long) simStats.violations);
+}
+
+/* A sequential upload over an older image with a resume session. Journaling
+ * the progress after each block must not drop the erase-ahead of the next
+ * block's first page, which the main loop starts before that block arrives. */
+static void testJournal(usbaspTransport_t* t) {
+	static uint8_t image[8 * TEST_BLOCKSIZE];
+	uint8_t session[8] = { 0x01, 0x02, 0x03, 0x04 };
+	unsigned long address, next, i;
+	uint8_t flags, reply[2];
+	uint64_t done;
+	uint8_t setup[8];
+	int r;
+
+	(void) t;
+	simDeviceInit(0x42);
+	memset(simFlash, 0x00, sizeof(image));
+	pattern(image, sizeof(image), 0);
+
+	r = simControl(USBASP_FUNC_SETSESSION, 0, 0, session, sizeof(session), 0);
+	CHECK(r == sizeof(session), "SETSESSION returned %d", r);
+
+	for (address = 0; address < sizeof(image); address = next) {
+		next = address + TEST_BLOCKSIZE;
+		flags = (next < sizeof(image)) ? PROG_BLOCKFLAG_SEQUENTIAL : PROG_BLOCKFLAG_LAST;
+		if (!address)
+			flags |= PROG_BLOCKFLAG_FIRST;
+
+		setup[0] = 0x40;
+		setup[1] = USBASP_FUNC_WRITEFLASH;
+		setup[2] = address;
+		setup[3] = address >> 8;
+		setup[4] = 0;
+		setup[5] = flags;
+		setup[6] = TEST_BLOCKSIZE & 0xff;
+		setup[7] = TEST_BLOCKSIZE >> 8;
+		r = simDeviceControl(setup, &image[address], simNow(), &done);
+		CHECK(r == TEST_BLOCKSIZE, "WRITEFLASH 0x%05lx returned %d", address, r);
+
+		/* the host's turnaround, the main loop keeps running. Journaling
+		 * may have kept the device busy past the status stage */
+		if (done < simNow())
+			done = simNow();
+		simDeviceIdle(done + SIM_USB_TURNAROUND_NS);
+		if (next >= sizeof(image))
+			break;
+		for (i = 0; i < USBASP_HOST_PAGESIZE; i++) {
+			if (simFlash[next + i] != 0xff)
+				break;
+		}
+		CHECK(i == USBASP_HOST_PAGESIZE, "page 0x%05lx wasn't erased ahead", next);
+	}
+
+	r = simControl(USBASP_FUNC_GETRESUME, 0, 0, reply, sizeof(reply), 1);
+	CHECK((r == sizeof(reply)) && ((reply[0] | (reply[1] << 8)) == sizeof(image) / USBASP_HOST_PAGESIZE),
+			"GETRESUME returned page %d", reply[0] | (reply[1] << 8));
+	CHECK(!memcmp(simFlash, image, sizeof(image)), "the image isn't in flash");
+	CHECK(simStats.erases == sizeof(image) / USBASP_HOST_PAGESIZE, "%lu page erases",
+			(unsigned long) simStats.erases);
+	CHECK(simStats.violations == 0, "%lu hardware rule violations", (unsigned long) simStats.violations);
+}
+
+/* a loaded image of length bytes at address */
+static void testImage(usbaspImage_t* image, unsigned long address, unsigned long length) {
+	unsigned long i;
+
+	memset(image, 0, sizeof(*image));
+	memset(image->data, 0xff, sizeof(image->data));
+	pattern(&image->data[address], length, address);
+	for (i = address; i < address + length; i += USBASP_HOST_PAGESIZE) {
+		image->used[i / USBASP_HOST_PAGESIZE] = 1;
+	}
+	image->size = address + length;
+	image->ready = USBASP_HOST_FLASHSIZE;
+	image->done = 1;
+	image->status = USBASP_HOST_OK;
+	pthread_mutex_init(&image->lock, 0);
+	pthread_cond_init(&image->changed, 0);
+}
+
+/* the window comes from GETGEOMETRY, images reaching past it are refused
+ * before anything is erased or written */
+static void testWindow(usbaspTransport_t* t) {
+	static usbaspImage_t image;
+	usbaspUploadOptions_t options;
+	usbaspUploadStats_t stats;
+	uint8_t back[USBASP_HOST_PAGESIZE], blank[USBASP_HOST_PAGESIZE];
+	int r;
+
+	CHECK((t->flashstart == 0) && (t->flashend == FLASH_BOOT_START),
+			"window 0x%05lx-0x%05lx", t->flashstart, t->flashend);
+
+	/* as a device with a smaller application area would report it */
+	t->flashend = 0x10000;
+	usbaspUploadDefaults(&options);
+	testImage(&image, 0x0f000, 0x2000);
+	r = usbaspUpload(t, &image, &options, &stats);
+	CHECK(r == USBASP_HOST_ERANGE, "upload past the window returned %d", r);
+	CHECK(!stats.transfers, "%lu blocks written before refusing", (unsigned long) stats.transfers);
+
+	memset(blank, 0xff, sizeof(blank));
+	r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, 0x0f000, 0, back, sizeof(back), 1);
+	CHECK((r == sizeof(back)) && !memcmp(back, blank, sizeof(back)), "refused image was written");
+
+	testImage(&image, 0x0f000, 0x1000);
+	r = usbaspUpload(t, &image, &options, &stats);
+	CHECK(r == USBASP_HOST_OK, "upload up to the end of the window returned %d", r);
+}
+
+/* The UART link on a pseudo terminal that loses every fifth frame each
+ * way. An upload has to get through, and the single frame IN replies the
+ * device sends again for a repeated SETUP have to be the right ones. A
+ * longer reply may fail when its ACK is lost, but never return wrong data */
+static void testUart(usbaspTransport_t* sim) {
+	static usbaspImage_t image;
+	usbaspUploadOptions_t options;
+	usbaspUploadStats_t stats;
+	usbaspTransport_t* t;
+	uint8_t back[2 * USBASP_HOST_PAGESIZE];
+	unsigned long address;
+	char path[64];
+	pid_t pid;
+	int fd, r, status = -1;
+
+	(void) sim;
+	fd = simUartSpawn(0x43, 5, path, sizeof(path), &pid);
+	CHECK(fd >= 0, "no pseudo terminal");
+	if (fd < 0)
+		return;
+	r = usbaspOpenUart(&t, path);
+	close(fd);
+	CHECK(r == USBASP_HOST_OK, "opening %s returned %d", path, r);
+
+	if (r == USBASP_HOST_OK) {
+		usbaspUploadDefaults(&options);
+		testImage(&image, 0, 0x2000);
+		r = usbaspUpload(t, &image, &options, &stats);
+		CHECK(r == USBASP_HOST_OK, "upload returned %d", r);
+
+		for (address = 0; address < image.size; address += USBASP_HOST_PAGESIZE) {
+			r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, address, 0,
+					back, USBASP_HOST_PAGESIZE, 1);
+			CHECK((r == USBASP_HOST_PAGESIZE) && !memcmp(back, &image.data[address], r),
+					"READFLASH_LONG 0x%05lx returned %d", address, r);
+		}
+		for (address = 0; address < image.size; address += sizeof(back)) {
+			r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, address, 0,
+					back, sizeof(back), 1);
+			CHECK((r == USBASP_HOST_EIO)
+					|| ((r == sizeof(back)) && !memcmp(back, &image.data[address], r)),
+					"READFLASH_LONG 0x%05lx of two frames returned %d", address, r);
+		}
+		t->close(t);
+	}
+
+	waitpid(pid, &status, 0);
+	CHECK(WIFEXITED(status) && (WEXITSTATUS(status) == 0), "device exited with %d", status);
+}
+
+/* an upload and readback through the feature reports of the HID build */
+static void testHid(usbaspTransport_t* sim) {
+	static usbaspImage_t image;
+	usbaspUploadOptions_t options;
+	usbaspUploadStats_t stats;
+	usbaspTransport_t* t;
+	uint8_t back[2 * USBASP_HOST_PAGESIZE];
+	unsigned long address;
+	int r;
+
+	(void) sim;
+	r = usbaspOpenSimHid(&t, 0x44);
+	CHECK(r == USBASP_HOST_OK, "opening returned %d", r);
+	if (r != USBASP_HOST_OK)
+		return;
+
+	usbaspUploadDefaults(&options);
+	options.block = 4096;
+	testImage(&image, 0, 0x3000);
+	r = usbaspUpload(t, &image, &options, &stats);
+	CHECK(r == USBASP_HOST_OK, "upload returned %d", r);
+
+	for (address = 0; address < image.size; address += sizeof(back) - 3) {
+		r = usbaspControl(t, USBASP_FUNC_READFLASH_LONG, address, 0, back, sizeof(back) - 3, 1);
+		CHECK((r == sizeof(back) - 3) && !memcmp(back, &image.data[address], r),
+				"READFLASH_LONG 0x%05lx returned %d", address, r);
+	}
+
+	/* neither a page aligned block nor a short data stage */
+	r = usbaspControl(t, USBASP_FUNC_WRITEFLASH_LONG, 0x100, 0, back, 128, 0);
+	CHECK(r == USBASP_HOST_EIO, "unaligned WRITEFLASH_LONG returned %d", r);
+	t->close(t);
+}
+
+static const struct {
+	const char* name;
+	void (*run)(usbaspTransport_t* t);
+} tests[] = {
+	{ "long address", testLongAddress },
+	{ "scatter-gather", testScatterGather },
+	{ "RLE readback", testRle },
+	{ "services", testServices },
+	{ "journal and erase-ahead", testJournal },
+	{ "writable window", testWindow },
+	{ "UART link", testUart },
+	{ "HID feature reports", testHid },
+};
+
+int main(void) {
+	usbaspTransport_t* t;
+	unsigned i;
+	int before;
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		printf("%s\n", tests[i].name);
+		/* a fresh blank device for every test */
+		if (usbaspOpenSim(&t, 0x42) < 0) {
+			printf("  FAILED: no simulated device\n");
+			return 1;
+		}
+		before = failures;
+		tests[i].run(t);
+		t->close(t);
+		if (failures == before)
+			printf("  ok\n");
+	}
+	printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
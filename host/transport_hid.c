@@ -0,0 +1,286 @@
+/*
+ * transport_hid.c - part of USBasp bootloader host tools
+ *
+ * Description....: Transport to the HID build through its feature reports
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/hidraw.h>
+
+#include "usbasphost.h"
+
+#define HID_REPORT_TYPE_FEATURE 3
+#define HID_RQ_CLASS_OUT        0x21    /* class, interface */
+#define HID_RQ_CLASS_IN         0xa1
+#define HID_RQ_GET_REPORT       0x01
+#define HID_RQ_SET_REPORT       0x09
+
+/* with the report ID in front */
+#define HID_COMMAND_SIZE        (1 + USBASP_HID_COMMANDLEN)
+#define HID_WRITEPAGE_SIZE      (1 + 4 + USBASP_HID_PAGELEN)
+#define HID_READPAGE_SIZE       (1 + USBASP_HID_PAGELEN)
+
+#define HID_MAX_HIDRAW          64
+
+/* The vendor requests of the library are carried by the feature reports of
+ * usbasp.h (BOOT_CFG_HID): WRITEFLASH_LONG as one WRITEPAGE report per page,
+ * the flash and EEPROM reads as a COMMAND report and READPAGE reports,
+ * everything else as a COMMAND report with its short data stage. Requests
+ * that don't fit (READFLASH_RLE, scatter-gather, long data stages of other
+ * requests) fail with USBASP_HOST_EIO. One report is on the bus at a time,
+ * through hidraw or as class requests to a simulated device. */
+typedef struct {
+	usbaspTransport_t t;
+	int fd;                         /* hidraw, or -1 */
+	usbaspTransport_t* sim;         /* the simulated device otherwise */
+	usbaspTransfer_t* head;
+	usbaspTransfer_t* tail;
+	uint8_t report[HID_WRITEPAGE_SIZE];
+} hidTransport_t;
+
+/* SET_REPORT or GET_REPORT of a feature report, h->report holds its ID
+ * and data. Returns the report's size or USBASP_HOST_E* */
+static int hidFeature(hidTransport_t* h, uint8_t set, uint16_t size) {
+	uint8_t setup[8];
+	int r;
+
+	if (h->fd >= 0) {
+		r = ioctl(h->fd, set ? HIDIOCSFEATURE(size) : HIDIOCGFEATURE(size), h->report);
+		return (r < 0) ? USBASP_HOST_EIO : size;
+	}
+
+	setup[0] = set ? HID_RQ_CLASS_OUT : HID_RQ_CLASS_IN;
+	setup[1] = set ? HID_RQ_SET_REPORT : HID_RQ_GET_REPORT;
+	setup[2] = h->report[0];
+	setup[3] = HID_REPORT_TYPE_FEATURE;
+	setup[4] = 0;
+	setup[5] = 0;
+	setup[6] = size;
+	setup[7] = size >> 8;
+	r = usbaspControlSetup(h->sim, setup, h->report);
+	return ((r >= 0) && (r != size)) ? USBASP_HOST_EIO : r;
+}
+
+static int hidCommand(hidTransport_t* h, usbaspTransfer_t* transfer, uint16_t length, uint8_t in) {
+	memset(h->report, 0, HID_COMMAND_SIZE);
+	h->report[0] = USBASP_HID_REPORT_COMMAND;
+	memcpy(&h->report[1], transfer->setup, sizeof(transfer->setup));
+	if (!in)
+		memcpy(&h->report[1 + sizeof(transfer->setup)], transfer->data, length);
+	return hidFeature(h, 1, HID_COMMAND_SIZE);
+}
+
+static int hidRun(hidTransport_t* h, usbaspTransfer_t* transfer) {
+	uint8_t request = transfer->setup[1];
+	uint16_t value = transfer->setup[2] | (transfer->setup[3] << 8);
+	uint16_t index = transfer->setup[4] | (transfer->setup[5] << 8);
+	uint16_t length = transfer->setup[6] | (transfer->setup[7] << 8);
+	uint8_t in = transfer->setup[0] & 0x80;
+	unsigned long address;
+	uint16_t pos, n;
+	uint8_t flags;
+	int r;
+
+	if ((request == USBASP_FUNC_WRITEFLASH_LONG) && !in) {
+		address = value | ((unsigned long)(index & 0xff) << 16);
+		flags = index >> 8;
+		if ((address % USBASP_HID_PAGELEN) || (length % USBASP_HID_PAGELEN))
+			return USBASP_HOST_EIO;
+		for (pos = 0; pos < length; pos += USBASP_HID_PAGELEN, address += USBASP_HID_PAGELEN) {
+			h->report[0] = USBASP_HID_REPORT_WRITEPAGE;
+			h->report[1] = address;
+			h->report[2] = address >> 8;
+			h->report[3] = address >> 16;
+			/* the pages of a block follow each other */
+			h->report[4] = flags | ((pos + USBASP_HID_PAGELEN < length) ? PROG_BLOCKFLAG_SEQUENTIAL : 0);
+			memcpy(&h->report[5], &transfer->data[pos], USBASP_HID_PAGELEN);
+			r = hidFeature(h, 1, HID_WRITEPAGE_SIZE);
+			if (r < 0)
+				return r;
+		}
+		return length;
+	}
+
+	if (in && ((request == USBASP_FUNC_READFLASH) || (request == USBASP_FUNC_READFLASH_LONG)
+			|| (request == USBASP_FUNC_READEEPROM))) {
+		r = hidCommand(h, transfer, length, in);
+		for (pos = 0; (r >= 0) && (pos < length); pos += n) {
+			n = (length - pos > USBASP_HID_PAGELEN) ? USBASP_HID_PAGELEN : length - pos;
+			h->report[0] = USBASP_HID_REPORT_READPAGE;
+			r = hidFeature(h, 0, HID_READPAGE_SIZE);
+			if (r >= 0)
+				memcpy(&transfer->data[pos], &h->report[1], n);
+		}
+		return (r < 0) ? r : length;
+	}
+
+	if ((request == USBASP_FUNC_READFLASH_RLE) || (request == USBASP_FUNC_WRITEFLASH_SG)
+			|| (request == USBASP_FUNC_SETREADLIST)
+			|| (length > (in ? USBASP_HID_COMMANDLEN : USBASP_HID_COMMANDLEN - 8)))
+		return USBASP_HOST_EIO;
+
+	/* the report holds the whole reply, padded, so it is taken as wLength.
+	 * After a data stage it holds what the engine made of it */
+	r = hidCommand(h, transfer, length, in);
+	if ((r >= 0) && (in || length)) {
+		h->report[0] = USBASP_HID_REPORT_COMMAND;
+		r = hidFeature(h, 0, HID_COMMAND_SIZE);
+		if ((r >= 0) && in)
+			memcpy(transfer->data, &h->report[1], length);
+		else if ((r >= 0) && (h->report[1] == 0xff))
+			r = USBASP_HOST_EIO;
+	}
+	return (r < 0) ? r : length;
+}
+
+static uint64_t hidClock(usbaspTransport_t* t) {
+	hidTransport_t* h = (void*)t;
+	struct timespec ts;
+
+	if (h->sim)
+		return h->sim->clock(h->sim);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int hidSubmit(usbaspTransport_t* t, usbaspTransfer_t* transfer) {
+	hidTransport_t* h = (void*)t;
+
+	transfer->submitted = hidClock(t);
+	transfer->next = 0;
+	if (h->tail)
+		h->tail->next = transfer;
+	else
+		h->head = transfer;
+	h->tail = transfer;
+	t->pending++;
+	return USBASP_HOST_OK;
+}
+
+static int hidEvents(usbaspTransport_t* t, int timeout) {
+	hidTransport_t* h = (void*)t;
+	usbaspTransfer_t* transfer = h->head;
+
+	(void) timeout;
+	if (!transfer)
+		return 0;
+
+	h->head = transfer->next;
+	if (!h->head)
+		h->tail = 0;
+	t->pending--;
+
+	transfer->result = hidRun(h, transfer);
+	transfer->done(transfer);
+	return 1;
+}
+
+static void hidClose(usbaspTransport_t* t) {
+	hidTransport_t* h = (void*)t;
+
+	while (h->head) {
+		hidEvents(t, 0);
+	}
+	if (h->sim)
+		h->sim->close(h->sim);
+	if (h->fd >= 0)
+		close(h->fd);
+	free(h);
+}
+
+static hidTransport_t* hidNew(void) {
+	hidTransport_t* h = calloc(1, sizeof(*h));
+
+	if (!h)
+		return 0;
+	h->fd = -1;
+	h->t.submit = hidSubmit;
+	h->t.events = hidEvents;
+	h->t.clock = hidClock;
+	h->t.close = hidClose;
+	return h;
+}
+
+/* a hidraw node of the HID build, or -1 */
+static int hidOpenNode(const char* path) {
+	struct hidraw_devinfo info;
+	int fd = open(path, O_RDWR);
+
+	if (fd < 0)
+		return -1;
+	if ((ioctl(fd, HIDIOCGRAWINFO, &info) < 0)
+			|| ((uint16_t) info.vendor != USBASP_USB_VID)
+			|| ((uint16_t) info.product != USBASP_USB_PID_HID)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int usbaspOpenHidraw(usbaspTransport_t** t, const char* path) {
+	hidTransport_t* h = hidNew();
+	usbaspIdentity_t identity;
+	char node[32];
+	uint8_t i, nibble;
+	int r;
+
+	if (!h)
+		return USBASP_HOST_EIO;
+
+	if (path) {
+		h->fd = hidOpenNode(path);
+	} else {
+		for (i = 0; (i < HID_MAX_HIDRAW) && (h->fd < 0); i++) {
+			snprintf(node, sizeof(node), "/dev/hidraw%u", i);
+			h->fd = hidOpenNode(node);
+		}
+	}
+	if (h->fd < 0) {
+		free(h);
+		return USBASP_HOST_ENODEV;
+	}
+
+	r = usbaspGetIdentity(&h->t, &identity);
+	if (r == USBASP_HOST_OK)
+		r = usbaspGetWindow(&h->t);
+	if (r < 0) {
+		hidClose(&h->t);
+		return USBASP_HOST_ENODEV;
+	}
+	for (i = 0; i < 2 * USBASP_SERIAL_LEN; i++) {
+		nibble = (i & 1) ? (identity.serial[i >> 1] & 0x0f) : (identity.serial[i >> 1] >> 4);
+		h->t.serial[i] = (nibble < 10) ? ('0' + nibble) : ('A' + nibble - 10);
+	}
+
+	*t = &h->t;
+	return USBASP_HOST_OK;
+}
+
+int usbaspOpenSimHid(usbaspTransport_t** t, uint32_t serial) {
+	hidTransport_t* h = hidNew();
+	int r;
+
+	if (!h)
+		return USBASP_HOST_EIO;
+
+	r = usbaspOpenSim(&h->sim, serial);
+	if (r < 0) {
+		free(h);
+		return r;
+	}
+	memcpy(h->t.serial, h->sim->serial, sizeof(h->t.serial));
+	h->t.flashstart = h->sim->flashstart;
+	h->t.flashend = h->sim->flashend;
+
+	*t = &h->t;
+	return USBASP_HOST_OK;
+}
@@ -0,0 +1,229 @@
+/*
+ * transport_libusb.c - part of USBasp bootloader host tools
+ *
+ * Description....: Transport to real devices through libusb's async API
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "usbasphost.h"
+
+#if USBASP_HOST_LIBUSB
+
+#include <libusb.h>
+
+#define USB_TIMEOUT     5000
+
+/* several control transfers may be queued on endpoint 0 at once, usbfs
+ * hands them to the host controller in order */
+typedef struct {
+	usbaspTransport_t t;
+	libusb_context* context;
+	libusb_device_handle* handle;
+	int dispatched;
+	uint8_t gone;
+} usbTransport_t;
+
+static void LIBUSB_CALL usbCallback(struct libusb_transfer* xfer) {
+	usbaspTransfer_t* transfer = xfer->user_data;
+	usbTransport_t* u = transfer->priv;
+
+	switch (xfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		transfer->result = xfer->actual_length;
+		if (transfer->setup[0] & LIBUSB_ENDPOINT_IN)
+			memcpy(transfer->data, libusb_control_transfer_get_data(xfer), xfer->actual_length);
+		break;
+	case LIBUSB_TRANSFER_STALL:
+		transfer->result = USBASP_HOST_ESTALL;
+		break;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		transfer->result = USBASP_HOST_EGONE;
+		u->gone = 1;
+		break;
+	default:
+		transfer->result = USBASP_HOST_EIO;
+		break;
+	}
+
+	free(xfer->buffer);
+	libusb_free_transfer(xfer);
+	u->t.pending--;
+	u->dispatched++;
+	transfer->done(transfer);
+}
+
+static uint64_t usbClock(usbaspTransport_t* t) {
+	struct timespec ts;
+
+	(void) t;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int usbSubmit(usbaspTransport_t* t, usbaspTransfer_t* transfer) {
+	usbTransport_t* u = (void*)t;
+	uint16_t length = transfer->setup[6] | (transfer->setup[7] << 8);
+	struct libusb_transfer* xfer;
+	uint8_t* buffer;
+
+	if (u->gone)
+		return USBASP_HOST_EGONE;
+
+	xfer = libusb_alloc_transfer(0);
+	buffer = malloc(LIBUSB_CONTROL_SETUP_SIZE + length);
+	if (!xfer || !buffer) {
+		libusb_free_transfer(xfer);
+		free(buffer);
+		return USBASP_HOST_EIO;
+	}
+
+	memcpy(buffer, transfer->setup, LIBUSB_CONTROL_SETUP_SIZE);
+	if (!(transfer->setup[0] & LIBUSB_ENDPOINT_IN) && length)
+		memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, transfer->data, length);
+	libusb_fill_control_transfer(xfer, u->handle, buffer, usbCallback, transfer, USB_TIMEOUT);
+	transfer->priv = u;
+	transfer->submitted = usbClock(t);
+
+	if (libusb_submit_transfer(xfer) < 0) {
+		free(buffer);
+		libusb_free_transfer(xfer);
+		return USBASP_HOST_EIO;
+	}
+	t->pending++;
+	return USBASP_HOST_OK;
+}
+
+static int usbEvents(usbaspTransport_t* t, int timeout) {
+	usbTransport_t* u = (void*)t;
+	struct timeval tv = { timeout / 1000, (timeout % 1000) * 1000 };
+	int r;
+
+	u->dispatched = 0;
+	r = libusb_handle_events_timeout_completed(u->context, &tv, &u->dispatched);
+	if (r < 0)
+		return USBASP_HOST_EIO;
+	return u->dispatched;
+}
+
+static void usbClose(usbaspTransport_t* t) {
+	usbTransport_t* u = (void*)t;
+
+	while (t->pending > 0) {
+		if (usbEvents(t, 1000) < 0)
+			break;
+	}
+	libusb_close(u->handle);
+	libusb_exit(u->context);
+	free(u);
+}
+
+/* open the device if it is the bootloader, a USBasp programmer has the same
+ * IDs but refuses GETGEOMETRY */
+static int usbOpenDevice(libusb_context* context, libusb_device* dev, const char* serial,
+		usbTransport_t** result) {
+	struct libusb_device_descriptor descriptor;
+	usbTransport_t* u;
+
+	if ((libusb_get_device_descriptor(dev, &descriptor) < 0)
+			|| (descriptor.idVendor != USBASP_USB_VID)
+			|| (descriptor.idProduct != USBASP_USB_PID))
+		return USBASP_HOST_ENODEV;
+
+	u = calloc(1, sizeof(*u));
+	if (!u)
+		return USBASP_HOST_EIO;
+	u->context = context;
+	u->t.submit = usbSubmit;
+	u->t.events = usbEvents;
+	u->t.clock = usbClock;
+	u->t.close = usbClose;
+
+	if (libusb_open(dev, &u->handle) < 0) {
+		free(u);
+		return USBASP_HOST_ENODEV;
+	}
+	if ((libusb_get_string_descriptor_ascii(u->handle, descriptor.iSerialNumber,
+			(uint8_t*)u->t.serial, sizeof(u->t.serial)) < 0)
+			|| (serial && strcmp(serial, u->t.serial))
+			|| (usbaspGetWindow(&u->t) < 0)) {
+		libusb_close(u->handle);
+		free(u);
+		return USBASP_HOST_ENODEV;
+	}
+
+	*result = u;
+	return USBASP_HOST_OK;
+}
+
+int usbaspOpenUsb(usbaspTransport_t** t, const char* serial) {
+	libusb_context* context;
+	libusb_device** list;
+	usbTransport_t* u = 0;
+	ssize_t n, i;
+
+	if (libusb_init(&context) < 0)
+		return USBASP_HOST_ENODEV;
+
+	n = libusb_get_device_list(context, &list);
+	for (i = 0; i < n; i++) {
+		if (usbOpenDevice(context, list[i], serial, &u) == USBASP_HOST_OK)
+			break;
+	}
+	if (n >= 0)
+		libusb_free_device_list(list, 1);
+
+	if (!u) {
+		libusb_exit(context);
+		return USBASP_HOST_ENODEV;
+	}
+	*t = &u->t;
+	return USBASP_HOST_OK;
+}
+
+int usbaspListUsb(char serials[][USBASP_HOST_SERIALLEN], int max) {
+	libusb_context* context;
+	libusb_device** list;
+	usbTransport_t* u;
+	ssize_t n, i;
+	int found = 0;
+
+	if (libusb_init(&context) < 0)
+		return 0;
+
+	n = libusb_get_device_list(context, &list);
+	for (i = 0; (i < n) && (found < max); i++) {
+		if (usbOpenDevice(context, list[i], 0, &u) != USBASP_HOST_OK)
+			continue;
+		memcpy(serials[found++], u->t.serial, USBASP_HOST_SERIALLEN);
+		libusb_close(u->handle);
+		free(u);
+	}
+	if (n >= 0)
+		libusb_free_device_list(list, 1);
+
+	libusb_exit(context);
+	return found;
+}
+
+#else
+
+int usbaspOpenUsb(usbaspTransport_t** t, const char* serial) {
+	(void) t;
+	(void) serial;
+	return USBASP_HOST_ENODEV;
+}
+
+int usbaspListUsb(char serials[][USBASP_HOST_SERIALLEN], int max) {
+	(void) serials;
+	(void) max;
+	return 0;
+}
+
+#endif /* USBASP_HOST_LIBUSB */
@@ -0,0 +1,159 @@
+/*
+ * transport_sim.c - part of USBasp bootloader host tools
+ *
+ * Description....: Transport to a simulated device in a child process
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "usbasphost.h"
+#include "sim/simdev.h"
+
+/* Transfers queue up like URBs at a host controller. The controller starts
+ * the next one as soon as the bus is free, the host only learns about a
+ * completion SIM_USB_TURNAROUND_NS later, and that is when it submits the
+ * next transfer from the callback. Everything runs on the device's bus
+ * time, so results don't depend on the machine the simulation runs on. */
+typedef struct {
+	usbaspTransport_t t;
+	int fd;
+	pid_t pid;
+	uint64_t now;           /* host time */
+	uint64_t busfree;       /* end of the last transfer on the bus */
+	usbaspTransfer_t* head;
+	usbaspTransfer_t* tail;
+	simMessage_t msg;
+} simTransport_t;
+
+static int simSubmit(usbaspTransport_t* t, usbaspTransfer_t* transfer) {
+	simTransport_t* s = (void*)t;
+
+	if (s->fd < 0)
+		return USBASP_HOST_EGONE;
+
+	transfer->submitted = s->now;
+	transfer->next = 0;
+	if (s->tail)
+		s->tail->next = transfer;
+	else
+		s->head = transfer;
+	s->tail = transfer;
+	t->pending++;
+	return USBASP_HOST_OK;
+}
+
+static int simRun(simTransport_t* s, usbaspTransfer_t* transfer) {
+	uint16_t length = transfer->setup[6] | (transfer->setup[7] << 8);
+	uint8_t in = transfer->setup[0] & 0x80;
+	ssize_t n;
+
+	if (length > SIM_MESSAGE_MAXDATA)
+		return USBASP_HOST_EIO;
+
+	s->msg.time = (transfer->submitted > s->busfree) ? transfer->submitted : s->busfree;
+	memcpy(s->msg.setup, transfer->setup, sizeof(s->msg.setup));
+	n = SIM_MESSAGE_HEADER;
+	if (!in && length) {
+		memcpy(s->msg.data, transfer->data, length);
+		n += length;
+	}
+	if (send(s->fd, &s->msg, n, 0) != n)
+		return USBASP_HOST_EGONE;
+
+	n = recv(s->fd, &s->msg, sizeof(s->msg), 0);
+	if (n < (ssize_t) SIM_MESSAGE_HEADER)
+		return USBASP_HOST_EGONE;
+
+	s->busfree = s->msg.time;
+	if (s->now < s->busfree + SIM_USB_TURNAROUND_NS)
+		s->now = s->busfree + SIM_USB_TURNAROUND_NS;
+
+	if (s->msg.result == SIM_STALL)
+		return USBASP_HOST_ESTALL;
+	if (in)
+		memcpy(transfer->data, s->msg.data, s->msg.result);
+	return s->msg.result;
+}
+
+static int simEvents(usbaspTransport_t* t, int timeout) {
+	simTransport_t* s = (void*)t;
+	usbaspTransfer_t* transfer = s->head;
+
+	(void) timeout;
+	if (!transfer)
+		return 0;
+
+	s->head = transfer->next;
+	if (!s->head)
+		s->tail = 0;
+	t->pending--;
+
+	transfer->result = (s->fd < 0) ? USBASP_HOST_EGONE : simRun(s, transfer);
+	if (transfer->result == USBASP_HOST_EGONE) {
+		close(s->fd);
+		s->fd = -1;
+	}
+	transfer->done(transfer);
+	return 1;
+}
+
+static uint64_t simClock(usbaspTransport_t* t) {
+	return ((simTransport_t*)t)->now;
+}
+
+static void simClose(usbaspTransport_t* t) {
+	simTransport_t* s = (void*)t;
+
+	while (s->head) {
+		simEvents(t, 0);
+	}
+	if (s->fd >= 0)
+		close(s->fd);
+	waitpid(s->pid, 0, 0);
+	free(s);
+}
+
+int usbaspOpenSim(usbaspTransport_t** t, uint32_t serial) {
+	simTransport_t* s = calloc(1, sizeof(*s));
+	usbaspIdentity_t identity;
+	uint8_t i, nibble;
+	int r;
+
+	if (!s)
+		return USBASP_HOST_EIO;
+
+	s->fd = simDeviceSpawn(serial, &s->pid);
+	if (s->fd < 0) {
+		free(s);
+		return USBASP_HOST_ENODEV;
+	}
+	s->t.submit = simSubmit;
+	s->t.events = simEvents;
+	s->t.clock = simClock;
+	s->t.close = simClose;
+
+	/* the serial number the USB descriptor would carry */
+	r = usbaspGetIdentity(&s->t, &identity);
+	if (r == USBASP_HOST_OK)
+		r = usbaspGetWindow(&s->t);
+	if (r < 0) {
+		simClose(&s->t);
+		return r;
+	}
+	for (i = 0; i < 2 * USBASP_SERIAL_LEN; i++) {
+		nibble = (i & 1) ? (identity.serial[i >> 1] & 0x0f) : (identity.serial[i >> 1] >> 4);
+		s->t.serial[i] = (nibble < 10) ? ('0' + nibble) : ('A' + nibble - 10);
+	}
+
+	*t = &s->t;
+	return USBASP_HOST_OK;
+}
@@ -0,0 +1,353 @@
+/*
+ * transport_uart.c - part of USBasp bootloader host tools
+ *
+ * Description....: Transport to devices on a serial line (BOOT_CFG_UART)
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+#include "usbasphost.h"
+#include "bootconfig.h"
+
+/* silence on the line that counts as a lost frame, and how often in a row
+ * the host goes back before it gives up */
+#define UART_TIMEOUT    50
+#define UART_RETRIES    20
+
+#define UART_FRAMELEN   (USBASP_UART_HEADERLEN + USBASP_UART_MAXDATA + 2)
+
+/* One transfer is on the line at a time. Its SETUP frame and the DATA
+ * frames of an OUT data stage go out with up to USBASP_UART_WINDOW of them
+ * unacked; an ACK covers its seq and everything before it. After a timeout
+ * the host goes back to the first unacked frame (see usbasp.h). */
+typedef struct {
+	usbaspTransport_t t;
+	int fd;
+	uint8_t seq;            /* last seq sent */
+	uint8_t synced;         /* the device has acked one of ours */
+	usbaspTransfer_t* head;
+	usbaspTransfer_t* tail;
+
+	/* received bytes and the frame being parsed from them, without SOF */
+	uint8_t buffer[512];
+	int start;
+	int end;
+	uint8_t frame[UART_FRAMELEN];
+	uint16_t pos;
+	uint16_t len;           /* 0 while waiting for SOF */
+} uartTransport_t;
+
+/* the same CRC-16 as avr-libc's _crc_ccitt_update() */
+static uint16_t uartCrc(uint16_t crc, uint8_t data) {
+	data ^= crc & 0xff;
+	data ^= data << 4;
+	return (((uint16_t) data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t) data << 3);
+}
+
+static int uartSend(uartTransport_t* u, uint8_t type, uint8_t seq, const uint8_t* data, uint16_t len) {
+	uint8_t frame[UART_FRAMELEN];
+	uint16_t crc = 0xffff;
+	int i, n = 0;
+	ssize_t r;
+
+	frame[0] = USBASP_UART_SOF;
+	frame[1] = type;
+	frame[2] = seq;
+	frame[3] = len;
+	frame[4] = len >> 8;
+	memcpy(&frame[USBASP_UART_HEADERLEN], data, len);
+	for (i = 1; i < USBASP_UART_HEADERLEN + len; i++) {
+		crc = uartCrc(crc, frame[i]);
+	}
+	frame[i++] = crc;
+	frame[i++] = crc >> 8;
+
+	while (n < i) {
+		r = write(u->fd, &frame[n], i - n);
+		if (r <= 0)
+			return USBASP_HOST_EGONE;
+		n += r;
+	}
+	return USBASP_HOST_OK;
+}
+
+/* wait for the next valid frame, returns 1 and its payload length in *n,
+ * 0 after UART_TIMEOUT ms of silence or USBASP_HOST_EGONE. The payload
+ * starts at &u->frame[USBASP_UART_HEADERLEN - 1] */
+static int uartReceive(uartTransport_t* u, uint16_t* n) {
+	struct pollfd p = { u->fd, POLLIN, 0 };
+	uint16_t crc, i, len;
+	uint8_t c;
+	ssize_t r;
+
+	for (;;) {
+		if (u->start == u->end) {
+			r = poll(&p, 1, UART_TIMEOUT);
+			if (r == 0)
+				return 0;
+			if (r > 0)
+				r = read(u->fd, u->buffer, sizeof(u->buffer));
+			if (r <= 0)
+				return USBASP_HOST_EGONE;
+			u->start = 0;
+			u->end = r;
+		}
+		c = u->buffer[u->start++];
+
+		if (u->len == 0) {
+			if (c == USBASP_UART_SOF) {
+				u->pos = 0;
+				u->len = USBASP_UART_HEADERLEN - 1;
+			}
+			continue;
+		}
+
+		u->frame[u->pos++] = c;
+		if (u->pos == USBASP_UART_HEADERLEN - 1) {
+			len = u->frame[2] | (u->frame[3] << 8);
+			if (len > USBASP_UART_MAXDATA) {
+				u->len = 0;
+				continue;
+			}
+			u->len += len + 2;
+		}
+		if (u->pos == u->len) {
+			u->len = 0;
+			crc = 0xffff;
+			for (i = 0; i < u->pos - 2; i++) {
+				crc = uartCrc(crc, u->frame[i]);
+			}
+			if ((u->frame[i] == (crc & 0xff)) && (u->frame[i + 1] == (crc >> 8))) {
+				*n = u->pos - (USBASP_UART_HEADERLEN + 1);
+				return 1;
+			}
+		}
+	}
+}
+
+/* send frame i of the transfer, the SETUP frame or a piece of the data stage */
+static int uartSendFrame(uartTransport_t* u, usbaspTransfer_t* transfer, uint8_t base, int i) {
+	uint16_t length = transfer->setup[6] | (transfer->setup[7] << 8);
+	uint16_t offset, n;
+
+	if (i == 0)
+		return uartSend(u, USBASP_UART_SETUP, base, transfer->setup, sizeof(transfer->setup));
+	offset = (i - 1) * USBASP_UART_MAXDATA;
+	n = (length - offset > USBASP_UART_MAXDATA) ? USBASP_UART_MAXDATA : length - offset;
+	return uartSend(u, USBASP_UART_DATA, base + i, &transfer->data[offset], n);
+}
+
+static int uartRun(uartTransport_t* u, usbaspTransfer_t* transfer) {
+	uint16_t length = transfer->setup[6] | (transfer->setup[7] << 8);
+	uint8_t in = transfer->setup[0] & 0x80;
+	uint8_t base = u->seq + 1;
+	uint8_t type, k;
+	uint8_t* payload = &u->frame[USBASP_UART_HEADERLEN - 1];
+	int frames, sent = 0, acked = 0, retries = 0;
+	int got = 0, pieces = 0;     /* IN data received */
+	uint16_t last = 0;
+	uint16_t n;
+	int r;
+
+	frames = 1;
+	if (!in)
+		frames += (length + USBASP_UART_MAXDATA - 1) / USBASP_UART_MAXDATA;
+
+	for (;;) {
+		while ((sent < frames) && (sent - acked < USBASP_UART_WINDOW)) {
+			r = uartSendFrame(u, transfer, base, sent++);
+			if (r < 0)
+				return r;
+		}
+
+		r = uartReceive(u, &n);
+		if (r < 0)
+			return r;
+		if (r == 0) {
+			/* go back, a repeated SETUP gets its IN data again */
+			if (++retries > UART_RETRIES)
+				return USBASP_HOST_EIO;
+			sent = acked;
+			got = pieces = 0;
+			continue;
+		}
+
+		type = u->frame[0];
+		k = u->frame[1] - base;
+		if (type == USBASP_UART_DATA) {
+			/* a lost piece shows as a gap in the seqs */
+			if (in && (k == pieces) && (got + n <= length)) {
+				memcpy(&transfer->data[got], payload, n);
+				got += n;
+				last = n;
+				pieces++;
+			} else if (in && (k < 0x80)) {
+				pieces = -1;
+			}
+			continue;
+		}
+		if ((type == USBASP_UART_RETRY) && (k == 0))
+			return USBASP_HOST_EIO;
+		if ((type != USBASP_UART_ACK) && (type != USBASP_UART_STALL))
+			continue;
+
+		if ((k == 0) && in && (type == USBASP_UART_ACK)
+				&& ((pieces <= 0) || ((got < length) && (last == USBASP_UART_MAXDATA)))) {
+			/* IN data went missing, ask for it again */
+			if (++retries > UART_RETRIES)
+				return USBASP_HOST_EIO;
+			sent = acked = got = pieces = 0;
+			continue;
+		}
+		if (k >= frames) {
+			/* the device went on from where an earlier host left it and
+			 * took our first frame for an old one, start after its seq */
+			if (!u->synced) {
+				base = u->frame[1] + 1;
+				sent = acked = got = pieces = 0;
+			}
+			continue;
+		}
+		u->synced = 1;
+		retries = 0;
+		if (type == USBASP_UART_STALL) {
+			/* nothing after it was taken, the next transfer starts anew */
+			u->seq = base + sent - 1;
+			return USBASP_HOST_ESTALL;
+		}
+		if (k + 1 > acked)
+			acked = k + 1;
+		if (acked == frames) {
+			u->seq = base + frames - 1;
+			return in ? got : length;
+		}
+	}
+}
+
+static uint64_t uartClock(usbaspTransport_t* t) {
+	struct timespec ts;
+
+	(void) t;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int uartSubmit(usbaspTransport_t* t, usbaspTransfer_t* transfer) {
+	uartTransport_t* u = (void*)t;
+
+	if (u->fd < 0)
+		return USBASP_HOST_EGONE;
+
+	transfer->submitted = uartClock(t);
+	transfer->next = 0;
+	if (u->tail)
+		u->tail->next = transfer;
+	else
+		u->head = transfer;
+	u->tail = transfer;
+	t->pending++;
+	return USBASP_HOST_OK;
+}
+
+static int uartEvents(usbaspTransport_t* t, int timeout) {
+	uartTransport_t* u = (void*)t;
+	usbaspTransfer_t* transfer = u->head;
+
+	(void) timeout;
+	if (!transfer)
+		return 0;
+
+	u->head = transfer->next;
+	if (!u->head)
+		u->tail = 0;
+	t->pending--;
+
+	transfer->result = (u->fd < 0) ? USBASP_HOST_EGONE : uartRun(u, transfer);
+	if (transfer->result == USBASP_HOST_EGONE) {
+		close(u->fd);
+		u->fd = -1;
+	}
+	transfer->done(transfer);
+	return 1;
+}
+
+static void uartClose(usbaspTransport_t* t) {
+	uartTransport_t* u = (void*)t;
+
+	while (u->head) {
+		uartEvents(t, 0);
+	}
+	if (u->fd >= 0)
+		close(u->fd);
+	free(u);
+}
+
+/* raw 8N1 at BOOT_CFG_UART_BAUD, which termios only knows as BOTHER */
+static int uartSetup(int fd) {
+	struct termios2 tio;
+
+	if (ioctl(fd, TCGETS2, &tio) < 0)
+		return -1;
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS | CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= CS8 | CREAD | CLOCAL | BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = BOOT_CFG_UART_BAUD;
+	tio.c_ospeed = BOOT_CFG_UART_BAUD;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	if (ioctl(fd, TCSETS2, &tio) < 0)
+		return -1;
+	return ioctl(fd, TCFLSH, TCIOFLUSH);
+}
+
+int usbaspOpenUart(usbaspTransport_t** t, const char* path) {
+	uartTransport_t* u = calloc(1, sizeof(*u));
+	usbaspIdentity_t identity;
+	uint8_t i, nibble;
+	int r;
+
+	if (!u)
+		return USBASP_HOST_EIO;
+
+	u->fd = open(path, O_RDWR | O_NOCTTY);
+	if ((u->fd < 0) || (uartSetup(u->fd) < 0)) {
+		if (u->fd >= 0)
+			close(u->fd);
+		free(u);
+		return USBASP_HOST_ENODEV;
+	}
+	/* somewhere the device won't have been lately */
+	u->seq = time(0) ^ getpid();
+	u->t.submit = uartSubmit;
+	u->t.events = uartEvents;
+	u->t.clock = uartClock;
+	u->t.close = uartClose;
+
+	r = usbaspGetIdentity(&u->t, &identity);
+	if (r == USBASP_HOST_OK)
+		r = usbaspGetWindow(&u->t);
+	if (r < 0) {
+		uartClose(&u->t);
+		return (r == USBASP_HOST_EIO) ? USBASP_HOST_ENODEV : r;
+	}
+	for (i = 0; i < 2 * USBASP_SERIAL_LEN; i++) {
+		nibble = (i & 1) ? (identity.serial[i >> 1] & 0x0f) : (identity.serial[i >> 1] >> 4);
+		u->t.serial[i] = (nibble < 10) ? ('0' + nibble) : ('A' + nibble - 10);
+	}
+
+	*t = &u->t;
+	return USBASP_HOST_OK;
+}
@@ -0,0 +1,187 @@
+/*
+ * usbasphost.h - part of USBasp bootloader host tools
+ *
+ * Description....: Asynchronous host library for the bootloader protocol
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __usbasphost_h_included__
+#define __usbasphost_h_included__
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "usbasp.h"
+#include "usbids.h"
+
+#define USBASP_HOST_PAGESIZE    256
+#define USBASP_HOST_FLASHSIZE   0x1E000UL   /* largest application area, see flashend */
+#define USBASP_HOST_PAGES       (USBASP_HOST_FLASHSIZE / USBASP_HOST_PAGESIZE)
+#define USBASP_HOST_SERIALLEN   (2 * USBASP_SERIAL_LEN + 1)
+
+/* results, transfers return the number of bytes moved instead of OK */
+#define USBASP_HOST_OK          0
+#define USBASP_HOST_ESTALL      (-1)    /* the device refused the request */
+#define USBASP_HOST_EIO         (-2)    /* transfer failed */
+#define USBASP_HOST_EGONE       (-3)    /* device left the bus */
+#define USBASP_HOST_EVERIFY     (-4)    /* CRC-32 mismatch after upload */
+#define USBASP_HOST_EFILE       (-5)    /* image could not be read */
+#define USBASP_HOST_ENODEV      (-6)    /* no such device */
+#define USBASP_HOST_ERANGE      (-7)    /* image outside the writable window */
+
+/* Transfers and transports
+ * A transfer is one vendor control transfer. submit() queues it and returns
+ * at once; done() is called from events() once it completed. Transfers on a
+ * device complete in the order they were submitted. */
+typedef struct usbaspTransfer {
+	uint8_t setup[8];
+	uint8_t* data;          /* wLength bytes, sent or received */
+	int result;             /* bytes of the data stage or USBASP_HOST_E* */
+	void (*done)(struct usbaspTransfer* transfer);
+	void* user;
+
+	uint64_t submitted;     /* clock() at submit(), set by the transport */
+	void* priv;             /* transport private */
+	struct usbaspTransfer* next;
+} usbaspTransfer_t;
+
+typedef struct usbaspTransport {
+	int (*submit)(struct usbaspTransport* t, usbaspTransfer_t* transfer);
+	/* dispatch completions, waits up to timeout ms for the first one.
+	 * Returns the number dispatched or USBASP_HOST_E* */
+	int (*events)(struct usbaspTransport* t, int timeout);
+	/* ns, wall time on real devices and bus time on simulated ones */
+	uint64_t (*clock)(struct usbaspTransport* t);
+	void (*close)(struct usbaspTransport* t);
+	int pending;            /* transfers submitted but not dispatched */
+	char serial[USBASP_HOST_SERIALLEN];
+	/* the flash the device accepts writes to, [flashstart, flashend) */
+	unsigned long flashstart;
+	unsigned long flashend;
+} usbaspTransport_t;
+
+/* Real devices through libusb's asynchronous API, serial selects one of
+ * several (NULL takes the first). Returns USBASP_HOST_ENODEV if libusb
+ * support wasn't built in. */
+int usbaspOpenUsb(usbaspTransport_t** t, const char* serial);
+
+/* serial numbers of all attached bootloaders, returns how many were found */
+int usbaspListUsb(char serials[][USBASP_HOST_SERIALLEN], int max);
+
+/* A simulated device: the bootloader's own engine.c, flash.c and journal.c
+ * running against a model of the part in a child process (see sim/). The
+ * device's bus time stands in for the clock. */
+int usbaspOpenSim(usbaspTransport_t** t, uint32_t serial);
+
+/* A device on a serial line (BOOT_CFG_UART) at BOOT_CFG_UART_BAUD. A lost
+ * frame is sent again after a timeout, but IN data longer than one frame
+ * can't be sent again by the device, such a transfer fails with
+ * USBASP_HOST_EIO when its ACK got lost. Wall time is the clock. */
+int usbaspOpenUart(usbaspTransport_t** t, const char* path);
+
+/* The HID build (BOOT_CFG_HID) through its feature reports, no driver
+ * needed. Uploads go as one WRITEPAGE report per page, flash and EEPROM
+ * reads as READPAGE reports, other requests with up to 24 bytes of data.
+ * usbaspOpenHidraw() takes a /dev/hidraw node or, with NULL, the first one
+ * of the HID build, wall time is the clock. usbaspOpenSimHid() sends the
+ * reports to a simulated device as class requests, on its bus time. */
+int usbaspOpenHidraw(usbaspTransport_t** t, const char* path);
+int usbaspOpenSimHid(usbaspTransport_t** t, uint32_t serial);
+
+/* Synchronous requests, built on submit() and events() */
+int usbaspControlSetup(usbaspTransport_t* t, const uint8_t* setup, uint8_t* data);
+int usbaspControl(usbaspTransport_t* t, uint8_t request, uint16_t value, uint16_t index,
+		uint8_t* data, uint16_t length, uint8_t in);
+int usbaspGetGeometry(usbaspTransport_t* t, usbaspGeometry_t* geometry);
+/* fill in flashstart and flashend from GETGEOMETRY and, on A/B slot builds,
+ * GETSLOTS. The open functions do this */
+int usbaspGetWindow(usbaspTransport_t* t);
+int usbaspGetIdentity(usbaspTransport_t* t, usbaspIdentity_t* identity);
+int usbaspCrc32(usbaspTransport_t* t, uint16_t page, uint16_t pages, uint32_t* crc);
+int usbaspChipErase(usbaspTransport_t* t);
+int usbaspDisconnect(usbaspTransport_t* t);
+
+/* Read flash with USBASP_FUNC_READFLASH_RLE, up to block encoded bytes per
+ * request. Every request is preceded by SETLONGADDRESS, which leaves the
+ * device in long address mode for the plain READFLASH/WRITEFLASH requests */
+int usbaspReadRle(usbaspTransport_t* t, unsigned long address, uint8_t* data,
+		unsigned long length, uint16_t block);
+
+/* decode one READFLASH_RLE reply into at most max bytes, returns the number
+ * of bytes decoded or USBASP_HOST_EIO if the reply is malformed */
+long usbaspRleDecode(const uint8_t* in, int n, uint8_t* out, unsigned long max);
+
+/* standard CRC-32, matching USBASP_FUNC_CRC32 */
+uint32_t usbaspHostCrc32(uint32_t crc, const uint8_t* data, unsigned long length);
+
+/* Images
+ * Intel HEX or ELF, loaded into a map of the application area. A loader
+ * thread fills it while the upload already runs: ready is the address below
+ * which no further record can change, it only moves ahead while records
+ * come in ascending order and jumps to the end once the file is done. */
+typedef struct {
+	uint8_t data[USBASP_HOST_FLASHSIZE];
+	uint8_t used[USBASP_HOST_PAGES];    /* page holds bytes of the image */
+	unsigned long size;                 /* end of the highest record */
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	unsigned long ready;
+	int status;                         /* USBASP_HOST_OK or EFILE once done */
+	uint8_t done;
+	pthread_t thread;
+	char path[256];
+} usbaspImage_t;
+
+int usbaspImageLoad(usbaspImage_t* image, const char* path);
+int usbaspImageLoadAsync(usbaspImage_t* image, const char* path);
+
+/* wait until the image is final below address, returns 0 if loading failed */
+uint8_t usbaspImageWait(usbaspImage_t* image, unsigned long address);
+
+/* wait for the loader thread, returns its status */
+int usbaspImageFinish(usbaspImage_t* image);
+
+/* does a page hold anything but 0xff */
+uint8_t usbaspImagePageUsed(const usbaspImage_t* image, uint16_t page);
+
+/* USBASP_HOST_ERANGE if a used page lies outside the device's writable
+ * window, the device would drop those writes. Only for loaded images */
+int usbaspImageCheck(const usbaspImage_t* image, const usbaspTransport_t* t);
+
+/* Pipelined upload
+ * The image is written with WRITEFLASH_LONG in blocks of up to block bytes,
+ * with up to depth transfers queued so the bus never idles between blocks.
+ * Pages that hold only 0xff are left to the chip erase. An image outside
+ * the writable window is refused with USBASP_HOST_ERANGE, before the erase
+ * if it is loaded already, otherwise once the loader gets there. */
+typedef struct {
+	int depth;              /* transfers kept queued, 1 waits for each */
+	uint16_t block;         /* bytes per request, a multiple of the page size */
+	uint8_t erase;          /* chip erase first */
+	uint8_t verify;         /* CRC-32 of the written ranges afterwards */
+	void (*progress)(void* user, unsigned long done, unsigned long total);
+	void* user;
+} usbaspUploadOptions_t;
+
+typedef struct {
+	unsigned long bytes;    /* image bytes written */
+	uint32_t transfers;
+	uint64_t latency;       /* ns from submit to completion, summed over the blocks */
+	uint64_t latencymin;
+	uint64_t latencymax;
+	uint64_t erase;         /* ns spent on the chip erase */
+	uint64_t write;         /* ns spent writing */
+	uint64_t verify;        /* ns spent verifying */
+} usbaspUploadStats_t;
+
+void usbaspUploadDefaults(usbaspUploadOptions_t* options);
+int usbaspUpload(usbaspTransport_t* t, usbaspImage_t* image,
+		const usbaspUploadOptions_t* options, usbaspUploadStats_t* stats);
+
+/* compare the device's CRC-32 of every used range with the image */
+int usbaspVerify(usbaspTransport_t* t, const usbaspImage_t* image);
+
+#endif /* __usbasphost_h_included__ */
@@ -0,0 +1,83 @@
+/*
+ * journal.c - part of USBasp bootloader
+ *
+ * Description....: EEPROM progress journal for resumable uploads
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+
+#include "journal.h"
+#include "flash.h"
+#include "usbasp.h"
+
+static usbaspJournal_t* const journal = (void*)USBASP_EEPROM_JOURNAL;
+
+static uint8_t journal_active = 0;
+static uint8_t journal_latest;
+static uint16_t journal_page;
+static uint32_t journal_session;
+static uint32_t journal_hash;
+
+static uint8_t journalNewest(void) {
+	uint8_t i, seq, next;
+
+	for (i = 0; i < USBASP_JOURNAL_ENTRIES; i++) {
+		seq = eeprom_read_byte(&journal[i].seq);
+		next = eeprom_read_byte(&journal[(i + 1) % USBASP_JOURNAL_ENTRIES].seq);
+		if ((uint8_t)(seq + 1) != next)
+			return i;
+	}
+	return 0;
+}
+
+static void journalWrite(uint16_t page) {
+	uint8_t seq = eeprom_read_byte(&journal[journal_latest].seq) + 1;
+	uint8_t next = (journal_latest + 1) % USBASP_JOURNAL_ENTRIES;
+
+	/* EEPROM can't be written during spm */
+	boot_spm_busy_wait();
+
+	/* seq goes last, it makes the entry the newest one */
+	eeprom_update_dword(&journal[next].session, journal_session);
+	eeprom_update_dword(&journal[next].hash, journal_hash);
+	eeprom_update_word(&journal[next].page, page);
+	eeprom_update_byte(&journal[next].seq, seq);
+
+	journal_latest = next;
+	journal_page = page;
+}
+
+void journalBegin(uint32_t session, uint32_t hash) {
+	journal_session = session;
+	journal_hash = hash;
+	journal_latest = journalNewest();
+
+	if ((eeprom_read_dword(&journal[journal_latest].session) == session)
+			&& (eeprom_read_dword(&journal[journal_latest].hash) == hash)) {
+		journal_page = eeprom_read_word(&journal[journal_latest].page);
+	} else {
+		journalWrite(0);
+	}
+	journal_active = 1;
+}
+
+uint16_t journalResumePage(void) {
+	return journal_active ? journal_page : 0;
+}
+
+void journalProgress(unsigned long address) {
+	uint16_t page = address / SPM_PAGESIZE;
+
+	if (journal_active && (page >= journal_page + USBASP_JOURNAL_INTERVAL)) {
+		/* the pages below may still sit in the write cache, they have to be
+		 * in flash before they are journaled. The next page's erase-ahead
+		 * stays, the upload goes on there */
+		flashFlush((unsigned long) page * SPM_PAGESIZE);
+		journalWrite(page);
+	}
+}
@@ -0,0 +1,25 @@
+/*
+ * journal.h - part of USBasp bootloader
+ *
+ * Description....: EEPROM progress journal for resumable uploads
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __journal_h_included__
+#define __journal_h_included__
+
+#include <inttypes.h>
+
+/* start journaling an upload, picking up the progress of an earlier attempt
+ * with the same session ID and image hash */
+void journalBegin(uint32_t session, uint32_t hash);
+
+/* first page the current upload has to send, 0 without a matching session */
+uint16_t journalResumePage(void);
+
+/* record that everything below address has been written */
+void journalProgress(unsigned long address);
+
+#endif /* __journal_h_included__ */
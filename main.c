@@ -18,11 +18,21 @@
 #include <avr/pgmspace.h>
 #include <avr/boot.h>
 #include <avr/wdt.h>
+#include <string.h>
 
 #include "usbasp.h"
 #include "usbdrv.h"
 #include "clock.h"
 #include "uart.h"
+#include "engine.h"
+#include "flash.h"
+#include "bootconfig.h"
+#include "slots.h"
+#include "stage.h"
+#include "uartlink.h"
+#include "hid.h"
+#include "services.h"
+#include "selfupdate.h"
 
 #define MODULE_NAME "btld"
 #define LOGGING_ENABLE 1
@@ -31,20 +41,6 @@
 #define pb7LEDON PORTB |= (_BV(PB7));
 #define pb7LEDOFF PORTB &= ~(_BV(PB7));
 
-static uchar replyBuffer[8];
-
-static uchar prog_state = PROG_STATE_IDLE;
-static uchar prog_sck = USBASP_ISP_SCK_AUTO;
-
-static uchar prog_address_newmode = 0;
-static unsigned long prog_address;
-static unsigned int prog_nbytes = 0;
-static unsigned int prog_pagesize;
-static uchar prog_blockflags;
-static uint16_t prog_pagecounter;
-
-int finished = 0;
-
 const char ram_usbDescriptorString0[] = { /* language descriptor */
 	4,          /* sizeof(usbDescriptorString0): length of descriptor in bytes */
 	3,          /* descriptor type */
@@ -52,15 +48,18 @@ const char ram_usbDescriptorString0[] = { /* language descriptor */
 };
 
 const int ram_usbDescriptorStringVendor[] = {
-	USB_STRING_DESCRIPTOR_HEADER(13),
-	'w', 'w', 'w', '.', 'f', 'i', 's', 'c', 'h', 'l', '.', 'd', 'e'
+	USB_STRING_DESCRIPTOR_HEADER(USBASP_USB_VENDOR_NAME_LEN),
+	USBASP_USB_VENDOR_NAME
 };
 
 const int ram_usbDescriptorStringDevice[] = {
-	USB_STRING_DESCRIPTOR_HEADER(6),
-	'U', 'S', 'B', 'a', 's', 'p'
+	USB_STRING_DESCRIPTOR_HEADER(USBASP_USB_DEVICE_NAME_LEN),
+	USBASP_USB_DEVICE_NAME
 };
 
+/* filled in from the signature row or EEPROM by serialInit() */
+int ram_usbDescriptorStringSerial[1 + 2 * USBASP_SERIAL_LEN];
+
 const char ram_usbDescriptorDevice[] = {    /* USB device descriptor */
 	18,         /* sizeof(usbDescriptorDevice): length of descriptor in bytes */
 	USBDESCR_DEVICE,        /* descriptor type */
@@ -85,7 +84,7 @@ const char ram_usbDescriptorConfiguration[] = {    /* USB configuration descript
 	9,          /* sizeof(usbDescriptorConfiguration): length of descriptor in bytes */
 	USBDESCR_CONFIG,    /* descriptor type */
 	18 + 7 * USB_CFG_HAVE_INTRIN_ENDPOINT + 7 * USB_CFG_HAVE_INTRIN_ENDPOINT3 +
-				(USB_CFG_DESCR_PROPS_HID & 0xff), 0,
+				9 * BOOT_CFG_HID, 0,
 	/* total length of data returned (including inlined descriptors) */
 1,          /* number of interfaces in this configuration */
 1,          /* index of this configuration */
@@ -106,7 +105,7 @@ const char ram_usbDescriptorConfiguration[] = {    /* USB configuration descript
 		USB_CFG_INTERFACE_SUBCLASS,
 		USB_CFG_INTERFACE_PROTOCOL,
 		0,          /* string index for interface */
-	#if (USB_CFG_DESCR_PROPS_HID & 0xff)    /* HID descriptor */
+	#if BOOT_CFG_HID    /* HID descriptor */
 		9,          /* sizeof(usbDescrHID): length of descriptor in bytes */
 		USBDESCR_HID,   /* descriptor type: HID */
 		0x01, 0x01, /* BCD representation of HID version */
@@ -133,6 +132,30 @@ const char ram_usbDescriptorConfiguration[] = {    /* USB configuration descript
 	#endif
 };
 
+#if BOOT_CFG_HID
+const char ram_usbDescriptorHidReport[USB_CFG_HID_REPORT_DESCRIPTOR_LENGTH] = {
+	0x06, 0x00, 0xff,   /* USAGE_PAGE (Vendor Defined Page 1) */
+	0x09, 0x01,         /* USAGE (Vendor Usage 1) */
+	0xa1, 0x01,         /* COLLECTION (Application) */
+	0x15, 0x00,         /*   LOGICAL_MINIMUM (0) */
+	0x26, 0xff, 0x00,   /*   LOGICAL_MAXIMUM (255) */
+	0x75, 0x08,         /*   REPORT_SIZE (8) */
+	0x85, USBASP_HID_REPORT_COMMAND,    /* REPORT_ID */
+	0x95, USBASP_HID_COMMANDLEN,        /* REPORT_COUNT */
+	0x09, 0x00,         /*   USAGE (Undefined) */
+	0xb2, 0x02, 0x01,   /*   FEATURE (Data,Var,Abs,Buf) */
+	0x85, USBASP_HID_REPORT_WRITEPAGE,  /* REPORT_ID */
+	0x96, (4 + USBASP_HID_PAGELEN) & 0xff, (4 + USBASP_HID_PAGELEN) >> 8, /* REPORT_COUNT */
+	0x09, 0x00,         /*   USAGE (Undefined) */
+	0xb2, 0x02, 0x01,   /*   FEATURE (Data,Var,Abs,Buf) */
+	0x85, USBASP_HID_REPORT_READPAGE,   /* REPORT_ID */
+	0x96, USBASP_HID_PAGELEN & 0xff, USBASP_HID_PAGELEN >> 8, /* REPORT_COUNT */
+	0x09, 0x00,         /*   USAGE (Undefined) */
+	0xb2, 0x02, 0x01,   /*   FEATURE (Data,Var,Abs,Buf) */
+	0xc0                /* END_COLLECTION */
+};
+#endif
+
 usbMsgLen_t getStringDescriptor(struct usbRequest* rq) {
 	switch (rq->wValue.bytes[0])
 	{
@@ -149,11 +172,25 @@ usbMsgLen_t getStringDescriptor(struct usbRequest* rq) {
 		return sizeof(ram_usbDescriptorStringDevice);
 		break;
 	case 3: // usbDescriptorStringSerialNumber
+		usbMsgPtr = (uchar*)ram_usbDescriptorStringSerial;
+		return sizeof(ram_usbDescriptorStringSerial);
 		break;
 
 	default:
 		break;
 	}
+	return 0;
+}
+
+void serialInit(void) {
+	const uchar* serialBytes = engineSerial();
+	uchar i, nibble;
+
+	ram_usbDescriptorStringSerial[0] = USB_STRING_DESCRIPTOR_HEADER(2 * USBASP_SERIAL_LEN);
+	for (i = 0; i < 2 * USBASP_SERIAL_LEN; i++) {
+		nibble = (i & 1) ? (serialBytes[i >> 1] & 0x0f) : (serialBytes[i >> 1] >> 4);
+		ram_usbDescriptorStringSerial[i + 1] = (nibble < 10) ? ('0' + nibble) : ('A' + nibble - 10);
+	}
 }
 
 usbMsgLen_t usbFunctionDescriptor(struct usbRequest* rq) {
@@ -169,280 +206,93 @@ usbMsgLen_t usbFunctionDescriptor(struct usbRequest* rq) {
 	case USBDESCR_STRING:
 		return getStringDescriptor(rq);
 		break;
+#if BOOT_CFG_HID
+	case USBDESCR_HID:
+		usbMsgPtr = (uchar*)ram_usbDescriptorConfiguration + 18;
+		return 9;
+		break;
+	case USBDESCR_HID_REPORT:
+		usbMsgPtr = (uchar*)ram_usbDescriptorHidReport;
+		return sizeof(ram_usbDescriptorHidReport);
+		break;
+#endif
 	
 	default:
 	log_print("asking for unknown descriptor")
 		break;
 	}
+	return 0;
 }
 
-uchar usbFunctionSetup(uchar* data) {
-
-	usbRequest_t* rq = (void*)data;
-
-	uchar len = 0;
-
-	// log_print("request type: %x", rq->bmRequestType);
-
-	if (rq->bRequest == USBASP_FUNC_CONNECT) {
-		log_print("connecting");
-
-		/* set compatibility mode of address delivering */
-		prog_address_newmode = 0;
-
-		ledRedOn();
-
-	} else if (rq->bRequest == USBASP_FUNC_DISCONNECT) {
-		log_print("disconnecting");
-		finished = 1;
-		ledRedOff();
-
-	} else if (rq->bRequest == USBASP_FUNC_TRANSMIT) {
-		log_print("transmit request: %02x %02x %02x %02x ", data[2], data[3], data[4], data[5]);
-
-		// [0x30, 0x00, [byte], 0x00] - respond with signature bytes
-		switch (data[2])
-		{
-		case 0xac: // erase
-			// erase
-			len = 4;
-
-		case 0x30:
-			/* code */
-			replyBuffer[3] = boot_signature_byte_get(data[4] * 2);
-			len = 4;
-			break;
-		case 0x58:
-			switch (data[3]) {
-			case 0x00:
-				replyBuffer[3] = boot_lock_fuse_bits_get(GET_LOCK_BITS);
-				break;
-			case 0x08:
-				replyBuffer[3] = boot_lock_fuse_bits_get(GET_HIGH_FUSE_BITS);
-				break;
-			default:
-				break;
-			}
-			len = 4;
-			break;
-		case 0x50:
-			switch (data[3]) {
-			case 0x00:
-				replyBuffer[3] = boot_lock_fuse_bits_get(GET_LOW_FUSE_BITS);
-				break;
-			case 0x08:
-				replyBuffer[3] = boot_lock_fuse_bits_get(GET_EXTENDED_FUSE_BITS);
-				break;
-
-			default:
-				break;
-			}
-			len = 4;
-			break;
-		default:
-			break;
-		}
-
-
-	} else if (rq->bRequest == USBASP_FUNC_READFLASH) {
-
-		if (!prog_address_newmode)
-			prog_address = (data[3] << 8) | data[2];
-
-		prog_nbytes = (data[7] << 8) | data[6];
-		prog_state = PROG_STATE_READFLASH;
-		len = 0xff; /* multiple in */
-		// this allows reading after a write
-		boot_rww_enable_safe();
-		// log_print("read flash from 0x%lx", prog_address);
-
-	} else if (rq->bRequest == USBASP_FUNC_READEEPROM) {
-
-		if (!prog_address_newmode)
-			prog_address = (data[3] << 8) | data[2];
-
-		prog_nbytes = (data[7] << 8) | data[6];
-		prog_state = PROG_STATE_READEEPROM;
-		len = 0xff; /* multiple in */
-		//log_print("read EEPROM 0x%lx", prog_address);
+#if BOOT_CFG_HID
+static uchar hid_transfer;
+#endif
 
-	} else if (rq->bRequest == USBASP_FUNC_ENABLEPROG) {
-		log_print("enable prog");
-		replyBuffer[0] = 0;//ispEnterProgrammingMode();
-		len = 1;
+/* the V-USB callbacks only hand the request over to the engine */
+usbMsgLen_t usbFunctionSetup(uchar* data) {
+	uint16_t len;
 
-	} else if (rq->bRequest == USBASP_FUNC_WRITEFLASH) {
-		if (!prog_address_newmode)
-			prog_address = (data[3] << 8) | data[2];
+#if BOOT_CFG_USB_SHARE
+	if (serviceUsbCallbacks) {
+		uchar* reply = 0;
 
-		prog_pagesize = data[4];
-		prog_blockflags = data[5] & 0x0F;
-		prog_pagesize += (((unsigned int) data[5] & 0xF0) << 4);
-		if (prog_blockflags & PROG_BLOCKFLAG_FIRST) {
-			// log_print("first block, setting pagecounter");
-			prog_pagecounter = prog_pagesize;
-		}
-		prog_nbytes = (data[7] << 8) | data[6];
-		prog_state = PROG_STATE_WRITEFLASH;
-		len = 0xff; /* multiple out */
-		// log_print("write flash \naddr: 0x%lx\n pagesize: 0x%x\nblockflags: 0x%x\nnbytes: 0x%x", prog_address, prog_pagesize, prog_blockflags, prog_nbytes);
-		// log_print("page counter %d", prog_pagecounter);
-
-	} else if (rq->bRequest == USBASP_FUNC_WRITEEEPROM) {
-
-		if (!prog_address_newmode)
-			prog_address = (data[3] << 8) | data[2];
-
-		prog_pagesize = 0;
-		prog_blockflags = 0;
-		prog_nbytes = (data[7] << 8) | data[6];
-		prog_state = PROG_STATE_WRITEEEPROM;
-		len = 0xff; /* multiple out */
-		// log_print("write eeprom 0x%lx", prog_address);
-
-	} else if (rq->bRequest == USBASP_FUNC_SETLONGADDRESS) {
-
-		/* set new mode of address delivering (ignore address delivered in commands) */
-		prog_address_newmode = 1;
-		/* set new address */
-		prog_address = *((unsigned long*) &data[2]);
-		// log_print("set Long address to 0x%lx", prog_address);
-
-	} else if (rq->bRequest == USBASP_FUNC_SETISPSCK) {
-		log_print("set spi clock");
-
-		/* set sck option */
-		prog_sck = data[2];
-		replyBuffer[0] = 0;
-		len = 1;
-	
-	} else if (rq->bRequest == USBASP_FUNC_GETCAPABILITIES) {
-		// log_print("get capabilities asked");
-		replyBuffer[0] = 1;
-		replyBuffer[1] = 0;
-		replyBuffer[2] = 0;
-		replyBuffer[3] = 0;
-		len = 4;
+		len = serviceUsbCallbacks->setup(data, &reply);
+		usbMsgPtr = reply;
+		return len;
 	}
+#endif
+
+#if BOOT_CFG_HID
+	hid_transfer = ((data[0] & USBRQ_TYPE_MASK) == USBRQ_TYPE_CLASS);
+	if (hid_transfer)
+		return hidSetup((void*)data);
+#endif
 
-	usbMsgPtr = replyBuffer;
+#if BOOT_CFG_UART == 1
+	/* USB saw a request first, it keeps the session */
+	if (!uartLinkActive())
+		uartLinkDisable();
+#endif
 
-	return len;
+	len = engineSetup(data, &usbMsgPtr);
+	return (len == ENGINE_STREAM) ? USB_NO_MSG : len;
 }
 
 uchar usbFunctionRead(uchar* data, uchar len) {
-
-	uchar i;
-
-	/* check if programmer is in correct read state */
-	if ((prog_state != PROG_STATE_READFLASH) && (prog_state
-			!= PROG_STATE_READEEPROM)) {
-		return 0xff;
-	}
-
-	/* fill packet ISP mode */
-	for (i = 0; i < len; i++) {
-		if (prog_state == PROG_STATE_READFLASH) {
-			data[i] = (prog_address > UINT16_MAX) ? pgm_read_byte_far(prog_address) : pgm_read_byte_near(prog_address);
-		} else {
-			data[i] = eeprom_read_byte(prog_address);
-		}
-		prog_address++;
-	}
-
-	/* last packet? */
-	if (len < 8) {
-		prog_state = PROG_STATE_IDLE;
-	}
-
-	return len;
+#if BOOT_CFG_USB_SHARE
+	if (serviceUsbCallbacks)
+		return serviceUsbCallbacks->read(data, len);
+#endif
+#if BOOT_CFG_HID
+	if (hid_transfer)
+		return hidRead(data, len);
+#endif
+	return engineRead(data, len);
 }
 
 uchar usbFunctionWrite(uchar* data, uchar len) {
-
-	uchar retVal = 0;
-	uchar i;
-
-	/* check if programmer is in correct write state */
-	if ((prog_state != PROG_STATE_WRITEFLASH) && (prog_state
-			!= PROG_STATE_WRITEEEPROM) && (prog_state != PROG_STATE_TPI_WRITE)) {
-		return 0xff;
-	}
-
-	if (prog_state == PROG_STATE_TPI_WRITE)
-	{
-		// tpi_write_block(prog_address, data, len);
-		prog_address += len;
-		prog_nbytes -= len;
-		if(prog_nbytes <= 0)
-		{
-			prog_state = PROG_STATE_IDLE;
-			return 1;
-		}
-		return 0;
-	}
-
-	for (i = 0; i < len; i++) {
-
-		if (prog_state == PROG_STATE_WRITEFLASH) {
-			/* Flash */
-
-			if (prog_pagesize == 0) {
-				/* not paged */
-				log_print("write %05x not paged", prog_address);
-				// ispWriteFlash(prog_address, data[i], 1);
-			} else {
-				/* paged */
-				// boot fill writes in words, writing happens every other byte, but 
-				// both cases have to be dealt with otherwise a few bytes can go missing
-					
-				if ((prog_address & 0x01)) {
-					boot_page_fill_safe(prog_address, ((data[i] << 8) + data[i-1]));
-				} else {
-					boot_page_fill_safe(prog_address, ((data[i+1] << 8) + data[i]));
-				}
-				// ispWriteFlash(prog_address, data[i], 0);
-				prog_pagecounter--;
-				// log_print("page counter %d", prog_pagecounter);
-				if (prog_pagecounter == 0) {
-					// ispFlushPage(prog_address, data[i]);
-					boot_page_erase_safe(prog_address);
-					boot_page_write_safe(prog_address);
-					// log_print("write %05x page flush", prog_address);
-					prog_pagecounter = prog_pagesize;
-				}
-			}
-
-		} else {
-			/* EEPROM */
-			eeprom_write_byte(prog_address, data[i]);
-		}
-
-		prog_nbytes--;
-
-		if (prog_nbytes == 0) {
-			prog_state = PROG_STATE_IDLE;
-			if ((prog_blockflags & PROG_BLOCKFLAG_LAST) && (prog_pagecounter
-					!= prog_pagesize)) {
-
-				/* last block and page flush pending, so flush it now */
-				// ispFlushPage(prog_address, data[i]);
-				boot_page_write_safe(prog_address);
-				// log_print("write %05x last page", prog_address);
-			}
-
-			retVal = 1; // Need to return 1 when no more data is to be received
-		}
-
-		prog_address++;
-	}
-	// log_print("eow: prgad: 0x%05x", prog_address);
-
-	return retVal;
+#if BOOT_CFG_USB_SHARE
+	if (serviceUsbCallbacks)
+		return serviceUsbCallbacks->write(data, len);
+#endif
+#if BOOT_CFG_HID
+	if (hid_transfer)
+		return hidWrite(data, len);
+#endif
+	return engineFeed(data, len);
 }
 
 void launchApp() {
+#if BOOT_CFG_USB_SHARE
+	/* stay on the bus, the application takes the driver over with
+	 * bootServiceUsbInit() */
+	USB_INTR_ENABLE &= ~_BV(USB_INTR_ENABLE_BIT);
+#else
 	usbDeviceDisconnect();
+#endif
+#if BOOT_CFG_UART
+	uartLinkDisable();
+#endif
 	// put ISRs back to app
 	MCUCR = _BV(IVCE);
 	MCUCR = 0;
@@ -455,8 +305,32 @@ int main(void) {
 
 	char mcusr = MCUSR;
 	MCUSR = 0;
+	// a watchdog reset leaves the watchdog running
+	wdt_disable();
 
-	if (!(mcusr & _BV(EXTRF))) {
+#if BOOT_CFG_SELFUPDATE
+	// a self-update was armed but never finished
+	if (selfUpdatePending()) {
+		selfUpdateRun();
+	}
+#endif
+
+#if BOOT_CFG_AB_SLOTS
+	slotsInit();
+#endif
+#if BOOT_CFG_STAGING
+	stageCommit();
+	/* the staging region belongs to the application */
+	flashSetWindow(0, STAGE_START);
+#endif
+
+	// the application asked for the bootloader, this only counts once
+	uchar softentry = (eeprom_read_byte((uint8_t*) USBASP_EEPROM_ENTRY) == USBASP_ENTRY_MAGIC);
+	if (softentry) {
+		eeprom_write_byte((uint8_t*) USBASP_EEPROM_ENTRY, 0xff);
+	}
+
+	if (!softentry && !(mcusr & _BV(EXTRF))) {
 		launchApp();
 	}
 
@@ -475,10 +349,21 @@ int main(void) {
 
 	/* output SE0 for USB reset */
 	// DDRB = ~0;
+	uint64_t timer;
+#if BOOT_CFG_UART != 2
 	usbDeviceDisconnect();
-	uint64_t timer = UINT16_MAX * 20000;
-	while(timer--) __asm("nop");
+	if (softentry) {
+		/* the host already knows the device from the application, a 250ms
+		 * disconnect is enough to make it enumerate again */
+		clockInit();
+		for (i = 0; i < 3; i++)
+			clockWait(255);
+	} else {
+		timer = UINT16_MAX * 20000;
+		while(timer--) __asm("nop");
+	}
 	usbDeviceConnect();
+#endif
 
 	/* all USB and ISP pins inputs */
 	// DDRB = 0;
@@ -504,15 +389,28 @@ int main(void) {
 	// 	__asm("cbi 0x05, 7");
 	// }
 
+	engineInit();
+	serialInit();
+
 	/* main event loop */
+#if BOOT_CFG_UART
+	uartLinkInit();
+#endif
+#if BOOT_CFG_UART != 2
 	usbInit();
+#endif
 	log_print("bootloader initted");
 	sei();
 
 	DDRB |= _BV(PB7);
 	timer = 0;
-	while (!finished) {
-		usbPoll();
+	while (!(engineStatus() & ENGINE_STATUS_FINISHED)) {
+#if BOOT_CFG_UART
+		uartLinkPoll();
+		if (!uartLinkActive())
+#endif
+			usbPoll();
+		engineTask();
 		timer++;
 		if (60000 == timer){
 			if(PORTB & _BV(PB7)){
@@ -527,8 +425,21 @@ int main(void) {
 	// wait a second before booting so that avrdude doesn't think we've dissapeared
 	uint16_t cooldown = UINT16_MAX;
 	while (cooldown--) {
-		usbPoll();
+#if BOOT_CFG_UART
+		uartLinkPoll();
+		if (!uartLinkActive())
+#endif
+			usbPoll();
+	}
+
+	engineEnd();
+
+#if BOOT_CFG_SELFUPDATE
+	if (selfUpdatePending()) {
+		usbDeviceDisconnect();
+		selfUpdateRun();
 	}
+#endif
 
 	launchApp();
 
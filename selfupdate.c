@@ -0,0 +1,152 @@
+/*
+ * selfupdate.c - part of USBasp bootloader
+ *
+ * Description....: Rewriting the boot section from a staged image
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+#include <stddef.h>
+
+#include "selfupdate.h"
+
+#if BOOT_CFG_SELFUPDATE
+
+#include "usbasp.h"
+#include "flash.h"
+
+#define SELFUPDATE_PAGES    ((0x20000UL - FLASH_BOOT_START) / SPM_PAGESIZE)
+
+#define SELFUPDATE_FLAG     (USBASP_EEPROM_SELFUPDATE + offsetof(usbaspSelfUpdate_t, flag))
+#define SELFUPDATE_NPAGES   (USBASP_EEPROM_SELFUPDATE + offsetof(usbaspSelfUpdate_t, pages))
+
+uint8_t selfUpdateArm(uint16_t pages, uint32_t crc) {
+	unsigned long staged = USBASP_SELFUPDATE_START + (SELFUPDATE_COPIER - FLASH_BOOT_START);
+	uint16_t i;
+
+	/* a partial image would leave the old service table behind */
+	if (pages != SELFUPDATE_PAGES)
+		return 0;
+
+	flashIdle();
+	if (flashCrc32(USBASP_SELFUPDATE_START, (unsigned long) pages * SPM_PAGESIZE) != crc)
+		return 0;
+
+	/* the copier can't replace itself */
+	for (i = 0; i < SELFUPDATE_COPIER_SIZE; i++) {
+		if (flashReadByte(staged + i) != flashReadByte(SELFUPDATE_COPIER + i))
+			return 0;
+	}
+
+	eeprom_update_byte((uint8_t*) SELFUPDATE_NPAGES, pages);
+	eeprom_update_byte((uint8_t*) SELFUPDATE_FLAG, USBASP_SELFUPDATE_COMMIT);
+	return 1;
+}
+
+uint8_t selfUpdatePending(void) {
+	return eeprom_read_byte((uint8_t*) SELFUPDATE_FLAG) == USBASP_SELFUPDATE_COMMIT;
+}
+
+/* Everything below is placed in the copier pages and must not call anything
+ * outside of them, not even avr-libc or libgcc, that code is being replaced.
+ * The helpers are forced inline for that reason. */
+#define COPIER_INLINE   static inline __attribute__((always_inline))
+
+COPIER_INLINE uint8_t copierEepromRead(uint16_t address) {
+	while (EECR & _BV(EEPE));
+	EEAR = address;
+	EECR |= _BV(EERE);
+	return EEDR;
+}
+
+COPIER_INLINE void copierEepromWrite(uint16_t address, uint8_t value) {
+	while (EECR & _BV(EEPE));
+	EEAR = address;
+	EEDR = value;
+	__asm__ __volatile__ (
+		"sbi %0, %1\n\t"
+		"sbi %0, %2\n\t"
+		:: "I" (_SFR_IO_ADDR(EECR)), "I" (EEMPE), "I" (EEPE)
+	);
+}
+
+/* staged word at offset i, the reset page can be redirected to the copier */
+COPIER_INLINE uint16_t copierWord(unsigned long source, uint16_t i, uint8_t redirect) {
+	if (redirect && (i == 0))
+		return 0x940c;  /* jmp, the target is below 0x20000 */
+	if (redirect && (i == 2))
+		return (uint16_t) selfUpdateRun;    /* word address */
+	return pgm_read_word_far(source + i);
+}
+
+COPIER_INLINE void copierPage(unsigned long dest, unsigned long source, uint8_t redirect) {
+	uint16_t i;
+
+	for (i = 0; i < SPM_PAGESIZE; i += 2) {
+		if (pgm_read_word_far(dest + i) != copierWord(source, i, redirect))
+			break;
+	}
+	if (i == SPM_PAGESIZE)
+		return;
+
+	boot_page_erase(dest);
+	boot_spm_busy_wait();
+	for (i = 0; i < SPM_PAGESIZE; i += 2) {
+		boot_page_fill(dest + i, copierWord(source, i, redirect));
+	}
+	boot_page_write(dest);
+	boot_spm_busy_wait();
+}
+
+__attribute__((noreturn, noinline, used, section(".copier")))
+void selfUpdateCopy(void) {
+	unsigned long offset;
+	uint8_t page, pages;
+
+	if (copierEepromRead(SELFUPDATE_FLAG) == USBASP_SELFUPDATE_COMMIT) {
+		pages = copierEepromRead(SELFUPDATE_NPAGES);
+
+		/* the staged image is read from the application section */
+		boot_spm_busy_wait();
+		boot_rww_enable();
+
+		/* from now on every reset ends up here */
+		copierPage(FLASH_BOOT_START, USBASP_SELFUPDATE_START, 1);
+
+		for (page = 1; page < pages; page++) {
+			offset = (unsigned long) page * SPM_PAGESIZE;
+			if ((FLASH_BOOT_START + offset >= SELFUPDATE_COPIER)
+					&& (FLASH_BOOT_START + offset < SELFUPDATE_COPIER + SELFUPDATE_COPIER_SIZE))
+				continue;
+			copierPage(FLASH_BOOT_START + offset, USBASP_SELFUPDATE_START + offset, 0);
+		}
+
+		/* the real reset page goes last */
+		copierPage(FLASH_BOOT_START, USBASP_SELFUPDATE_START, 0);
+		copierEepromWrite(SELFUPDATE_FLAG, 0xff);
+	}
+
+	/* start whatever bootloader is in place now */
+	__asm__ __volatile__ ("jmp %0" :: "i" (FLASH_BOOT_START));
+	for (;;);
+}
+
+/* entered from main() or straight from the reset vector, in which case
+ * nothing has been set up */
+__attribute__((naked, noreturn, used, section(".copier")))
+void selfUpdateRun(void) {
+	__asm__ __volatile__ (
+		"clr __zero_reg__\n\t"
+		"cli\n\t"
+		"jmp selfUpdateCopy\n\t"
+	);
+	for (;;);
+}
+
+#endif /* BOOT_CFG_SELFUPDATE */
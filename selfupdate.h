@@ -0,0 +1,39 @@
+/*
+ * selfupdate.h - part of USBasp bootloader
+ *
+ * Description....: Rewriting the boot section from a staged image
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __selfupdate_h_included__
+#define __selfupdate_h_included__
+
+#include <inttypes.h>
+
+#include "bootconfig.h"
+
+#if BOOT_CFG_SELFUPDATE
+
+/* The copier lives in its own pages at a fixed address (see Makefile), which
+ * it never rewrites, and depends on nothing outside of them. It first points
+ * the reset vector at itself, so a power failure anywhere later restarts the
+ * copy, then copies every other page of the staged image that differs, and
+ * writes the real reset page last. Only an interruption of that first or
+ * last page write can leave the boot section unusable. */
+#define SELFUPDATE_COPIER       0x1FD00UL
+#define SELFUPDATE_COPIER_SIZE  0x200
+
+/* verify the staged image and arm the copier, returns 0 if refused */
+uint8_t selfUpdateArm(uint16_t pages, uint32_t crc);
+
+/* the copier is armed */
+uint8_t selfUpdatePending(void);
+
+/* copy the staged image and start the new bootloader */
+void selfUpdateRun(void) __attribute__((noreturn));
+
+#endif /* BOOT_CFG_SELFUPDATE */
+
+#endif /* __selfupdate_h_included__ */
@@ -0,0 +1,163 @@
+/*
+ * services.c - part of USBasp bootloader
+ *
+ * Description....: Bootloader services callable from the application
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+
+#include "bootconfig.h"
+#include "usbasp.h"
+#include "services.h"
+#include "flash.h"
+#include "usbdrv.h"
+
+#define SERVICE_STR(x)  #x
+#define SERVICE_XSTR(x) SERVICE_STR(x)
+
+/* Everything here runs on behalf of the application, with its stack and its
+ * RAM. Nothing may touch the bootloader's own variables. */
+
+/* placed at BOOT_SERVICE_TABLE by the linker (see Makefile) */
+__attribute__((naked, used, section(".services")))
+void serviceTable(void) {
+	__asm__ __volatile__ (
+		"jmp serviceVersion\n\t"
+		"jmp servicePageErase\n\t"
+		"jmp servicePageFill\n\t"
+		"jmp servicePageWrite\n\t"
+		"jmp servicePageProgram\n\t"
+		"jmp serviceCrc32\n\t"
+		"jmp serviceEepromUpdate\n\t"
+#if BOOT_CFG_USB_SHARE
+		"jmp serviceUsbInit\n\t"
+		"jmp usbPoll\n\t"
+		"jmp usbSetInterrupt\n\t"
+		"jmp " SERVICE_XSTR(USB_INTR_VECTOR) "\n\t"
+#else
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+#endif
+		/* unused entries */
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+		"jmp serviceRefused\n\t"
+	);
+}
+
+/* the application is about to change its own flash, so the fingerprint no
+ * longer describes it. The EEPROM write has finished before the next spm. */
+static void serviceFingerprintClear(void) {
+	usbaspFingerprint_t* record = (void*)USBASP_EEPROM_FINGERPRINT;
+
+	eeprom_update_word(&record->pages, USBASP_FINGERPRINT_NONE);
+}
+
+/* wait for spm and make the application section readable again before the
+ * application's interrupts come back */
+static void serviceFinish(uint8_t sreg) {
+	boot_spm_busy_wait();
+	boot_rww_enable();
+	SREG = sreg;
+}
+
+__attribute__((used))
+uint8_t serviceRefused(void) {
+	return BOOT_SERVICE_REFUSED;
+}
+
+__attribute__((used))
+uint16_t serviceVersion(void) {
+	return BOOT_SERVICE_VERSION;
+}
+
+__attribute__((used))
+uint8_t servicePageErase(uint32_t address) {
+	uint8_t sreg = SREG;
+
+	if (address >= FLASH_BOOT_START)
+		return BOOT_SERVICE_REFUSED;
+
+	cli();
+	serviceFingerprintClear();
+	eeprom_busy_wait();
+	boot_page_erase(address);
+	serviceFinish(sreg);
+	return BOOT_SERVICE_OK;
+}
+
+__attribute__((used))
+uint8_t servicePageFill(uint32_t address, uint16_t word) {
+	uint8_t sreg = SREG;
+
+	if (address >= FLASH_BOOT_START)
+		return BOOT_SERVICE_REFUSED;
+
+	cli();
+	boot_page_fill(address, word);
+	SREG = sreg;
+	return BOOT_SERVICE_OK;
+}
+
+__attribute__((used))
+uint8_t servicePageWrite(uint32_t address) {
+	uint8_t sreg = SREG;
+
+	if (address >= FLASH_BOOT_START)
+		return BOOT_SERVICE_REFUSED;
+
+	cli();
+	serviceFingerprintClear();
+	eeprom_busy_wait();
+	boot_page_write(address);
+	serviceFinish(sreg);
+	return BOOT_SERVICE_OK;
+}
+
+__attribute__((used))
+uint8_t servicePageProgram(uint32_t address, const uint8_t* data) {
+	uint8_t sreg = SREG;
+
+	address &= ~((uint32_t) SPM_PAGESIZE - 1);
+	if (address >= FLASH_BOOT_START)
+		return BOOT_SERVICE_REFUSED;
+
+	cli();
+	serviceFingerprintClear();
+	flashPageWrite(address, data);
+	serviceFinish(sreg);
+	return BOOT_SERVICE_OK;
+}
+
+__attribute__((used))
+uint32_t serviceCrc32(uint32_t address, uint32_t length) {
+	return flashCrc32(address, length);
+}
+
+__attribute__((used))
+void serviceEepromUpdate(uint16_t eeaddress, const void* data, uint16_t length) {
+	eeprom_update_block(data, (void*) eeaddress, length);
+}
+
+#if BOOT_CFG_USB_SHARE
+/* lives in the bootloader's RAM like the rest of the driver */
+const bootUsbCallbacks_t* serviceUsbCallbacks = 0;
+
+__attribute__((used))
+uint8_t serviceUsbInit(const bootUsbCallbacks_t* callbacks) {
+	serviceUsbCallbacks = callbacks;
+	usbInit();
+	usbDeviceConnect();
+	return BOOT_SERVICE_OK;
+}
+#endif
@@ -0,0 +1,87 @@
+/*
+ * services.h - part of USBasp bootloader
+ *
+ * Description....: Bootloader services callable from the application
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __services_h_included__
+#define __services_h_included__
+
+#include <inttypes.h>
+
+/* The last 64 bytes of the boot section hold a table of jmp instructions,
+ * entry n at BOOT_SERVICE_TABLE + 4 * n. Entries are only ever appended,
+ * check bootServiceVersion() before using anything newer than version 1.
+ * This header is meant to be included by applications as well.
+ *
+ * The services run with interrupts disabled while spm is busy and return
+ * with the application section readable again, so the application's
+ * interrupt vectors can stay where they are. Nothing in the boot section can
+ * be erased or written, such calls return BOOT_SERVICE_REFUSED. Erasing or
+ * writing a page clears the application fingerprint (see usbasp.h). */
+#define BOOT_SERVICE_TABLE      0x1FFC0UL
+#define BOOT_SERVICE_VERSION    2
+
+#define BOOT_SERVICE_OK         0
+#define BOOT_SERVICE_REFUSED    1
+
+/* word address of entry n, what an indirect call needs */
+#define BOOT_SERVICE(n)         ((BOOT_SERVICE_TABLE + 4 * (n)) / 2)
+
+#define bootServiceVersion() \
+	((uint16_t (*)(void)) BOOT_SERVICE(0))()
+#define bootServicePageErase(address) \
+	((uint8_t (*)(uint32_t)) BOOT_SERVICE(1))(address)
+#define bootServicePageFill(address, word) \
+	((uint8_t (*)(uint32_t, uint16_t)) BOOT_SERVICE(2))(address, word)
+#define bootServicePageWrite(address) \
+	((uint8_t (*)(uint32_t)) BOOT_SERVICE(3))(address)
+/* erase, fill and write a whole page from RAM */
+#define bootServicePageProgram(address, data) \
+	((uint8_t (*)(uint32_t, const uint8_t*)) BOOT_SERVICE(4))(address, data)
+/* same CRC-32 as zlib's crc32() */
+#define bootServiceCrc32(address, length) \
+	((uint32_t (*)(uint32_t, uint32_t)) BOOT_SERVICE(5))(address, length)
+/* only the bytes that differ are written */
+#define bootServiceEepromUpdate(eeaddress, data, length) \
+	((void (*)(uint16_t, const void*, uint16_t)) BOOT_SERVICE(6))(eeaddress, data, length)
+
+/* Version 2: the bootloader's V-USB driver, only in bootloaders built with
+ * SHARE_USB=1 (see Makefile), bootServiceUsbInit() returns
+ * BOOT_SERVICE_REFUSED otherwise.
+ *
+ * The bootloader's RAM then starts at 0x3000 and survives the jump to the
+ * application, which has to stay below it (link with
+ * -Wl,--defsym=__stack=0x802fff). The bootloader stays on the bus when it
+ * hands over, so a device the host already knows doesn't enumerate again.
+ * The descriptors remain the bootloader's, the callbacks get every class and
+ * vendor request. setup() returns the reply length with *reply pointing to
+ * it in RAM, or 0xffff to continue with read() or write() like V-USB's
+ * USB_NO_MSG. The application routes the USB interrupt with
+ * BOOT_SERVICE_USB_VECTOR(INT2_vect) and enables interrupts. */
+typedef struct {
+	uint16_t (*setup)(uint8_t* data, uint8_t** reply);
+	uint8_t (*write)(uint8_t* data, uint8_t len);
+	uint8_t (*read)(uint8_t* data, uint8_t len);
+} bootUsbCallbacks_t;
+
+#define bootServiceUsbInit(callbacks) \
+	((uint8_t (*)(const bootUsbCallbacks_t*)) BOOT_SERVICE(7))(callbacks)
+#define bootServiceUsbPoll() \
+	((void (*)(void)) BOOT_SERVICE(8))()
+#define bootServiceUsbSetInterrupt(data, len) \
+	((void (*)(uint8_t*, uint8_t)) BOOT_SERVICE(9))(data, len)
+#define BOOT_SERVICE_USB_VECTOR(vector) \
+	ISR(vector, ISR_NAKED) { \
+		__asm__ __volatile__ ("jmp %0" :: "i" (BOOT_SERVICE_TABLE + 4 * 10)); \
+	}
+
+#if defined(BOOT_CFG_USB_SHARE) && BOOT_CFG_USB_SHARE
+/* bootloader side, set once the application has taken the driver over */
+extern const bootUsbCallbacks_t* serviceUsbCallbacks;
+#endif
+
+#endif /* __services_h_included__ */
@@ -0,0 +1,128 @@
+/*
+ * slots.c - part of USBasp bootloader
+ *
+ * Description....: A/B application slots with atomic switch-over
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <string.h>
+
+#include "slots.h"
+#include "flash.h"
+
+#if BOOT_CFG_AB_SLOTS
+
+#define SLOT_VECTORS    (_VECTORS_SIZE / 4)
+
+static usbaspSlots_t* const record = (void*)USBASP_EEPROM_SLOTS;
+static usbaspFingerprint_t* const fingerprint = (void*)USBASP_EEPROM_FINGERPRINT;
+
+static unsigned long slotBase(uint8_t slot) {
+	return slot ? SLOT_B_START : SLOT_A_START;
+}
+
+/* check a slot's image against the CRC stored when it was activated */
+static uint8_t slotValid(uint8_t slot) {
+	uint16_t pages = eeprom_read_word(&record->pages[slot]);
+
+	if ((pages == USBASP_SLOT_EMPTY) || ((unsigned long) pages * SPM_PAGESIZE > SLOT_SIZE))
+		return 0;
+	return flashCrc32(slotBase(slot), (unsigned long) pages * SPM_PAGESIZE)
+			== eeprom_read_dword(&record->crc[slot]);
+}
+
+/* jmp into the active slot's own vector table */
+static void slotsVectors(uint8_t* page, uint8_t slot) {
+	unsigned long target;
+	uint16_t i;
+
+	memset(page, 0xff, SPM_PAGESIZE);
+	for (i = 0; i < SLOT_VECTORS; i++) {
+		/* jmp k: 1001 010k kkkk 110k, kkkk kkkk kkkk kkkk (word address) */
+		target = (slotBase(slot) >> 1) + 2 * i;
+		page[4 * i + 0] = 0x0c | ((target >> 13) & 0xf0) | ((target >> 16) & 0x01);
+		page[4 * i + 1] = 0x94 | ((target >> 21) & 0x01);
+		page[4 * i + 2] = target;
+		page[4 * i + 3] = target >> 8;
+	}
+}
+
+static void slotsWriteVectors(uint8_t slot) {
+	uint8_t page[SPM_PAGESIZE];
+	uint16_t i;
+
+	slotsVectors(page, slot);
+
+	flashIdle();
+	for (i = 0; i < 4 * SLOT_VECTORS; i++) {
+		if (flashReadByte(SLOT_VECTOR_PAGE + i) != page[i])
+			break;
+	}
+	if (i == 4 * SLOT_VECTORS)
+		return;
+
+	/* page 0 is hashed into the fingerprint as well */
+	eeprom_update_word(&fingerprint->pages, USBASP_FINGERPRINT_NONE);
+	flashPageWrite(SLOT_VECTOR_PAGE, page);
+	flashIdle();
+}
+
+static void slotsOpen(uint8_t active) {
+	uint8_t inactive = (active == 0) ? 1 : 0;
+
+	flashSetWindow(slotBase(inactive), slotBase(inactive) + SLOT_SIZE);
+}
+
+void slotsInit(void) {
+	uint8_t active = eeprom_read_byte(&record->active);
+
+	/* roll back if the active slot lost or damaged its image */
+	if ((active != USBASP_SLOT_NONE) && !slotValid(active)) {
+		if (slotValid(active ^ 1)) {
+			active ^= 1;
+		} else {
+			active = USBASP_SLOT_NONE;
+		}
+		eeprom_update_byte(&record->active, active);
+	}
+
+	if (active != USBASP_SLOT_NONE)
+		slotsWriteVectors(active);
+
+	slotsOpen(active);
+}
+
+void slotsGet(usbaspSlots_t* slots) {
+	eeprom_read_block(slots, record, sizeof(usbaspSlots_t));
+	slots->base[0] = SLOT_A_START;
+	slots->base[1] = SLOT_B_START;
+}
+
+uint8_t slotsActivate(uint16_t pages, uint32_t crc) {
+	uint8_t active = eeprom_read_byte(&record->active);
+	uint8_t target = (active == 0) ? 1 : 0;
+
+	if ((pages == 0) || ((unsigned long) pages * SPM_PAGESIZE > SLOT_SIZE))
+		return 0;
+
+	flashIdle();
+	if (flashCrc32(slotBase(target), (unsigned long) pages * SPM_PAGESIZE) != crc)
+		return 0;
+
+	/* describe the new image first, flipping the active byte is the atomic
+	 * switch-over. A power loss before the vector page is rewritten is
+	 * repaired by slotsInit() */
+	eeprom_update_dword(&record->crc[target], crc);
+	eeprom_update_word(&record->pages[target], pages);
+	eeprom_update_byte(&record->active, target);
+
+	slotsWriteVectors(target);
+	slotsOpen(target);
+	return 1;
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * slots.h - part of USBasp bootloader
+ *
+ * Description....: A/B application slots with atomic switch-over
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __slots_h_included__
+#define __slots_h_included__
+
+#include <inttypes.h>
+#include "bootconfig.h"
+#include "usbasp.h"
+
+/* Flash layout with BOOT_CFG_AB_SLOTS:
+ * page 0 holds a table of jumps into the active slot's interrupt vectors and
+ * is only ever written by the bootloader, the two slots follow. An image has
+ * to be linked with -Ttext set to the start of the slot it is written to. */
+#define SLOT_VECTOR_PAGE    0x00000UL
+#define SLOT_A_START        0x00100UL
+#define SLOT_SIZE           0x0EF00UL
+#define SLOT_B_START        (SLOT_A_START + SLOT_SIZE)
+
+#if BOOT_CFG_AB_SLOTS
+
+/* repair the vector page after a power loss during a switch-over, roll back
+ * to the other slot if the active one fails its CRC, and open the inactive slot
+ * for writing. Call once at startup before launching the application */
+void slotsInit(void);
+
+/* fill in the slot record for USBASP_FUNC_GETSLOTS */
+void slotsGet(usbaspSlots_t* slots);
+
+/* verify the first pages of the inactive slot against crc and make it the
+ * active one, returns 0 (and keeps the current slot) if verification fails */
+uint8_t slotsActivate(uint16_t pages, uint32_t crc);
+
+#endif
+
+#endif /* __slots_h_included__ */
@@ -0,0 +1,74 @@
+/*
+ * stage.c - part of USBasp bootloader
+ *
+ * Description....: Commit of an image staged by the application
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#include "stage.h"
+#include "flash.h"
+#include "usbasp.h"
+
+#if BOOT_CFG_STAGING
+
+static usbaspStage_t* const record = (void*)USBASP_EEPROM_STAGE;
+static usbaspFingerprint_t* const fingerprint = (void*)USBASP_EEPROM_FINGERPRINT;
+
+void stageCommit(void) {
+	uint8_t page[SPM_PAGESIZE];
+	uint16_t pages, progress, i;
+	unsigned long src, dst;
+
+	if (eeprom_read_byte(&record->flag) != USBASP_STAGE_COMMIT)
+		return;
+
+	pages = eeprom_read_word(&record->pages);
+	progress = eeprom_read_word(&record->progress);
+
+	/* the staging region isn't touched by the copy, so this holds on resume */
+	if (((unsigned long) pages * SPM_PAGESIZE > STAGE_SIZE)
+			|| (flashCrc32(STAGE_START, (unsigned long) pages * SPM_PAGESIZE)
+			!= eeprom_read_dword(&record->crc))) {
+		eeprom_update_byte(&record->flag, 0xff);
+		return;
+	}
+
+	/* the application is replaced, its fingerprint no longer holds */
+	eeprom_update_word(&fingerprint->pages, USBASP_FINGERPRINT_NONE);
+
+	for (; progress < pages; progress++) {
+		src = STAGE_START + (unsigned long) progress * SPM_PAGESIZE;
+		dst = (unsigned long) progress * SPM_PAGESIZE;
+
+		/* staging and application are both in the RWW section, so wait for
+		 * the last write before reading */
+		flashIdle();
+		for (i = 0; i < SPM_PAGESIZE; i++) {
+			page[i] = flashReadByte(src + i);
+		}
+		for (i = 0; i < SPM_PAGESIZE; i++) {
+			if (flashReadByte(dst + i) != page[i])
+				break;
+		}
+		if (i != SPM_PAGESIZE) {
+			flashPageWrite(dst, page);
+			/* the page has to be programmed before it is journaled, and
+			 * EEPROM can't be written while SPM is busy */
+			flashIdle();
+		}
+
+		/* the copy is idempotent, a power loss repeats at most this page */
+		eeprom_update_word(&record->progress, progress + 1);
+	}
+
+	flashIdle();
+	eeprom_update_word(&record->progress, 0);
+	eeprom_update_byte(&record->flag, 0xff);
+}
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * stage.h - part of USBasp bootloader
+ *
+ * Description....: Commit of an image staged by the application
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __stage_h_included__
+#define __stage_h_included__
+
+#include <inttypes.h>
+#include "bootconfig.h"
+
+/* Flash layout with BOOT_CFG_STAGING: the application in the lower half, the
+ * staging region in the upper half of the application area */
+#define STAGE_START         0x0F000UL
+#define STAGE_SIZE          (0x1E000UL - STAGE_START)
+
+#if BOOT_CFG_STAGING
+
+/* if the application requested a commit, verify the staged image and copy
+ * it into the application area, resuming where a previous attempt stopped.
+ * Call once at startup before launching the application */
+void stageCommit(void);
+
+#endif
+
+#endif /* __stage_h_included__ */
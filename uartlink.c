@@ -0,0 +1,308 @@
+/*
+ * uartlink.c - part of USBasp bootloader
+ *
+ * Description....: Bootloader protocol framed on UART0
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+#include <string.h>
+
+#include "uartlink.h"
+
+#if BOOT_CFG_UART
+
+#include "usbasp.h"
+#include "usbdrv.h"
+#include "engine.h"
+#include "clock.h"
+
+#if UART_RING_SIZE & (UART_RING_SIZE - 1)
+#error "UART_RING_SIZE has to be a power of two"
+#endif
+
+#define LINK_LISTEN     0
+#define LINK_ACTIVE     1
+#define LINK_OFF        2
+
+static volatile uint8_t ring[UART_RING_SIZE];
+static volatile uint16_t ring_head = 0;
+static uint16_t ring_tail = 0;
+
+static uint8_t link_state = LINK_LISTEN;
+
+/* frame without SOF, frame_len is 0 while waiting for SOF */
+static uint8_t frame[USBASP_UART_HEADERLEN - 1 + USBASP_UART_MAXDATA + 2];
+static uint16_t frame_pos;
+static uint16_t frame_len = 0;
+
+static uint8_t link_synced = 0;
+static uint8_t link_seq;            /* last accepted frame */
+static uint8_t link_reply;          /* and what it was answered with */
+static uint8_t link_out = 0;        /* an OUT data stage is open */
+static uint16_t link_remaining;     /* and what is left of its wLength */
+
+/* what a repeated SETUP frame gets besides link_reply */
+#define RESEND_NOTHING  0
+#define RESEND_DATA     1           /* link_in */
+#define RESEND_RETRY    2           /* the IN data took more than one frame */
+
+static uint8_t link_resend = RESEND_NOTHING;
+static uint8_t link_in[USBASP_UART_MAXDATA];    /* the last IN data frame */
+static uint16_t link_inlen;
+
+ISR(USART0_RX_vect) {
+	uint16_t head = ring_head;
+
+	ring[head] = UDR0;
+	ring_head = (head + 1) & (UART_RING_SIZE - 1);
+}
+
+static void linkPut(uint8_t c, uint16_t* crc) {
+	while (!(UCSR0A & _BV(UDRE0)));
+	UDR0 = c;
+	if (crc)
+		*crc = _crc_ccitt_update(*crc, c);
+}
+
+static void linkSend(uint8_t type, uint8_t seq, const uint8_t* data, uint16_t len) {
+	uint16_t crc = 0xffff;
+
+	linkPut(USBASP_UART_SOF, 0);
+	linkPut(type, &crc);
+	linkPut(seq, &crc);
+	linkPut(len, &crc);
+	linkPut(len >> 8, &crc);
+	while (len--) {
+		linkPut(*data++, &crc);
+	}
+	linkPut(crc, 0);
+	linkPut(crc >> 8, 0);
+}
+
+/* run the IN data stage, returns 0 if the request failed. The frame is
+ * built in link_in, so a reply that fits one frame can be sent again */
+static uint8_t linkRead(uint8_t seq, uint16_t len, uint8_t* reply, uint16_t remaining) {
+	uint16_t n = 0, frames = 0;
+	uint8_t chunk, got;
+
+	link_inlen = 0;
+	while (remaining) {
+		chunk = (remaining > 8) ? 8 : remaining;
+		if (len != ENGINE_STREAM) {
+			got = (len > chunk) ? chunk : len;
+			memcpy(&link_in[n], reply, got);
+			reply += got;
+			len -= got;
+		} else {
+			got = engineRead(&link_in[n], chunk);
+			if (got > chunk)
+				return 0;
+		}
+		n += got;
+		remaining -= got;
+
+		/* a short frame ends the transfer like a short packet, so one that
+		 * ends short of wLength on a full frame gets an empty frame */
+		if ((n == sizeof(link_in)) || (got < chunk) || (remaining == 0)) {
+			linkSend(USBASP_UART_DATA, seq + frames, link_in, n);
+			link_inlen = n;
+			frames++;
+			n = 0;
+		}
+		if (got < chunk)
+			break;
+	}
+	/* the host counts on at least one DATA frame */
+	if (!frames)
+		linkSend(USBASP_UART_DATA, seq, link_in, 0);
+	link_resend = (frames > 1) ? RESEND_RETRY : RESEND_DATA;
+	return 1;
+}
+
+/* returns 0 if the request failed */
+static uint8_t linkSetup(uint8_t seq, uint8_t* data) {
+	usbRequest_t* rq = (void*)data;
+	uint8_t* reply;
+	uint16_t len;
+
+	link_out = 0;
+	link_resend = RESEND_NOTHING;
+	if ((rq->bmRequestType & USBRQ_TYPE_MASK) != USBRQ_TYPE_VENDOR)
+		return 0;
+
+	len = engineSetup(data, &reply);
+
+	if (rq->bmRequestType & USBRQ_DIR_DEVICE_TO_HOST)
+		return linkRead(seq, len, reply, rq->wLength.word);
+
+	link_out = (len == ENGINE_STREAM) && (rq->wLength.word != 0);
+	link_remaining = rq->wLength.word;
+	return 1;
+}
+
+/* returns 0 if the request failed */
+static uint8_t linkWrite(uint8_t* data, uint16_t len) {
+	uint8_t chunk, r;
+
+	link_resend = RESEND_NOTHING;
+	if (!link_out)
+		return 0;
+
+	/* like the USB driver, never pass more than wLength to the engine */
+	if (len > link_remaining)
+		len = link_remaining;
+
+	while (len) {
+		chunk = (len > 8) ? 8 : len;
+		r = engineFeed(data, chunk);
+		link_remaining -= chunk;
+		if (r || (link_remaining == 0)) {
+			link_out = 0;
+			return (r != 0xff);
+		}
+		data += chunk;
+		len -= chunk;
+	}
+	return 1;
+}
+
+static void linkActivate(void) {
+#if BOOT_CFG_UART == 1
+	/* drop off the bus, the receive interrupt has the CPU from now on */
+	USB_INTR_ENABLE &= ~_BV(USB_INTR_ENABLE_BIT);
+	usbDeviceDisconnect();
+#endif
+	UCSR0B |= _BV(RXCIE0);
+	link_state = LINK_ACTIVE;
+}
+
+static void linkFrame(void) {
+	uint8_t type = frame[0];
+	uint8_t seq = frame[1];
+	uint16_t len = frame[2] | (frame[3] << 8);
+	uint8_t* payload = &frame[USBASP_UART_HEADERLEN - 1];
+	uint8_t ok;
+
+	if (link_state == LINK_LISTEN)
+		linkActivate();
+
+	if (link_synced && (seq == link_seq)) {
+		/* the reply got lost, the request was already done and can't be
+		 * run again. IN data is sent again if it fit in one frame */
+		if ((type == USBASP_UART_SETUP) && (link_resend == RESEND_RETRY)) {
+			linkSend(USBASP_UART_RETRY, link_seq, 0, 0);
+			return;
+		}
+		if ((type == USBASP_UART_SETUP) && (link_resend == RESEND_DATA))
+			linkSend(USBASP_UART_DATA, link_seq, link_in, link_inlen);
+		linkSend(link_reply, link_seq, 0, 0);
+		return;
+	}
+	if (link_synced && ((uint8_t)(link_seq - seq) < USBASP_UART_WINDOW)) {
+		/* sent again by a host going back, it was done already */
+		linkSend(link_reply, link_seq, 0, 0);
+		return;
+	}
+
+	if ((type == USBASP_UART_SETUP) && (len == 8)) {
+		ok = linkSetup(seq, payload);
+	} else if ((type == USBASP_UART_DATA) && link_synced && (seq == (uint8_t)(link_seq + 1))) {
+		ok = linkWrite(payload, len);
+	} else {
+		/* out of order, tell the host where to go back to */
+		if (link_synced)
+			linkSend(link_reply, link_seq, 0, 0);
+		return;
+	}
+
+	link_synced = 1;
+	link_seq = seq;
+	link_reply = ok ? USBASP_UART_ACK : USBASP_UART_STALL;
+	linkSend(link_reply, link_seq, 0, 0);
+}
+
+void uartLinkInit(void) {
+	UBRR0 = F_CPU / (8UL * BOOT_CFG_UART_BAUD) - 1;
+	UCSR0A = _BV(U2X0);
+	UCSR0B = _BV(RXEN0) | _BV(TXEN0);
+	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+
+	/* keep an unconnected RXD from making up frames */
+	PORTD |= _BV(PD0);
+
+#if BOOT_CFG_UART == 2
+	linkActivate();
+#endif
+}
+
+void uartLinkPoll(void) {
+	uint16_t head, len;
+	uint8_t c;
+
+	if (link_state == LINK_OFF)
+		return;
+
+	/* no receive interrupt until the UART has won */
+	if (link_state == LINK_LISTEN) {
+		while (UCSR0A & _BV(RXC0)) {
+			ring[ring_head] = UDR0;
+			ring_head = (ring_head + 1) & (UART_RING_SIZE - 1);
+		}
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		head = ring_head;
+	}
+
+	while (ring_tail != head) {
+		c = ring[ring_tail];
+		ring_tail = (ring_tail + 1) & (UART_RING_SIZE - 1);
+
+		if (frame_len == 0) {
+			if (c == USBASP_UART_SOF) {
+				frame_pos = 0;
+				frame_len = USBASP_UART_HEADERLEN - 1;
+			}
+			continue;
+		}
+
+		frame[frame_pos++] = c;
+
+		if (frame_pos == USBASP_UART_HEADERLEN - 1) {
+			len = frame[2] | (frame[3] << 8);
+			if (len > USBASP_UART_MAXDATA) {
+				frame_len = 0;
+				continue;
+			}
+			frame_len += len + 2;
+		}
+
+		if (frame_pos == frame_len) {
+			uint16_t crc = 0xffff;
+
+			frame_len = 0;
+			for (len = 0; len < frame_pos - 2; len++) {
+				crc = _crc_ccitt_update(crc, frame[len]);
+			}
+			if ((frame[len] == (crc & 0xff)) && (frame[len + 1] == (crc >> 8)))
+				linkFrame();
+		}
+	}
+}
+
+uint8_t uartLinkActive(void) {
+	return link_state == LINK_ACTIVE;
+}
+
+void uartLinkDisable(void) {
+	UCSR0B = 0;
+	link_state = LINK_OFF;
+}
+
+#endif /* BOOT_CFG_UART */
@@ -0,0 +1,44 @@
+/*
+ * uartlink.h - part of USBasp bootloader
+ *
+ * Description....: Bootloader protocol framed on UART0
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __uartlink_h_included__
+#define __uartlink_h_included__
+
+#include <inttypes.h>
+
+#include "bootconfig.h"
+
+#if BOOT_CFG_UART
+
+/* The frames (see usbasp.h) are handed to the engine (see engine.h) in 8
+ * byte pieces, exactly like V-USB does, so both transports run the same
+ * requests.
+ *
+ * With BOOT_CFG_UART == 1 the receiver is polled until the first valid frame
+ * arrives, so it can't get in the way of the USB interrupt. The USB
+ * interrupt is then turned off and the receive interrupt takes over. */
+
+/* number of bytes buffered between the receive interrupt and uartLinkPoll,
+ * has to hold USBASP_UART_WINDOW frames */
+#define UART_RING_SIZE  1024
+
+void uartLinkInit(void);
+
+/* process received frames, call this from the main loop */
+void uartLinkPoll(void);
+
+/* the UART carries the session */
+uint8_t uartLinkActive(void);
+
+/* USB was first, stop listening */
+void uartLinkDisable(void);
+
+#endif /* BOOT_CFG_UART */
+
+#endif /* __uartlink_h_included__ */
@@ -11,6 +11,8 @@
 #ifndef USBASP_H_
 #define USBASP_H_
 
+#include <stdint.h>
+
 /* USB function call identifiers */
 #define USBASP_FUNC_CONNECT     1
 #define USBASP_FUNC_DISCONNECT  2
@@ -28,10 +30,224 @@
 #define USBASP_FUNC_TPI_RAWWRITE     14
 #define USBASP_FUNC_TPI_READBLOCK    15
 #define USBASP_FUNC_TPI_WRITEBLOCK   16
+#define USBASP_FUNC_READFLASH_RLE    32
+#define USBASP_FUNC_WRITEFLASH_SG    33
+#define USBASP_FUNC_SETREADLIST      34
+#define USBASP_FUNC_READFLASH_SG     35
+#define USBASP_FUNC_READFLASH_LONG   36
+#define USBASP_FUNC_WRITEFLASH_LONG  37
+#define USBASP_FUNC_GETGEOMETRY      38
+#define USBASP_FUNC_GETIDENTITY      39
+#define USBASP_FUNC_CRC32            40
+#define USBASP_FUNC_GETFINGERPRINT   41
+#define USBASP_FUNC_SETFINGERPRINT   42
+#define USBASP_FUNC_GETSLOTS         43
+#define USBASP_FUNC_ACTIVATESLOT     44
+#define USBASP_FUNC_SETSESSION       45
+#define USBASP_FUNC_GETRESUME        46
+#define USBASP_FUNC_SELFUPDATE       47
 #define USBASP_FUNC_GETCAPABILITIES 127
 
 /* USBASP capabilities */
 #define USBASP_CAP_0_TPI    0x01
+#define USBASP_CAP_1_LONGTRANSFERS 0x01 /* bytes 2..3 hold the max block size */
+
+/* largest block accepted in a single read or write request */
+#define USBASP_MAX_BLOCKSIZE    0x8000
+
+/* Extended capability and device geometry (USBASP_FUNC_GETGEOMETRY),
+ * all fields little endian */
+#define USBASP_PROTOCOL_VERSION 1
+
+#define USBASP_FEATURE_RLE          0x0001  /* USBASP_FUNC_READFLASH_RLE */
+#define USBASP_FEATURE_SG           0x0002  /* scatter-gather requests */
+#define USBASP_FEATURE_LONGADDRESS  0x0004  /* USBASP_FUNC_READFLASH_LONG/WRITEFLASH_LONG */
+#define USBASP_FEATURE_LONGTRANSFER 0x0008  /* blocks up to maxblock bytes */
+#define USBASP_FEATURE_BGERASE      0x0010  /* chip erase polled with 0xf0 */
+#define USBASP_FEATURE_ERASEAHEAD   0x0020  /* PROG_BLOCKFLAG_SEQUENTIAL */
+#define USBASP_FEATURE_PAGECACHE    0x0040  /* unaligned and partial writes are merged */
+#define USBASP_FEATURE_IDENTITY     0x0080  /* USBASP_FUNC_GETIDENTITY */
+#define USBASP_FEATURE_CRC32        0x0100  /* USBASP_FUNC_CRC32 */
+#define USBASP_FEATURE_FINGERPRINT  0x0200  /* USBASP_FUNC_GET/SETFINGERPRINT */
+#define USBASP_FEATURE_ABSLOTS      0x0400  /* USBASP_FUNC_GETSLOTS/ACTIVATESLOT */
+#define USBASP_FEATURE_RESUME       0x0800  /* USBASP_FUNC_SETSESSION/GETRESUME */
+#define USBASP_FEATURE_SELFUPDATE   0x1000  /* USBASP_FUNC_SELFUPDATE */
+
+typedef struct __attribute__((packed)) {
+	uint8_t  version;       /* USBASP_PROTOCOL_VERSION */
+	uint16_t features;      /* USBASP_FEATURE_* */
+	uint16_t pagesize;      /* SPM page size */
+	uint32_t flashsize;     /* writable bytes from 0, or from the inactive slot */
+	uint32_t bootstart;     /* first byte of the boot section */
+	uint16_t eepromsize;
+	uint16_t maxblock;      /* largest single read or write request */
+	uint16_t staging;       /* bytes of RAM write cache */
+} usbaspGeometry_t;
+
+/* Device identity (USBASP_FUNC_GETIDENTITY), everything a session would
+ * otherwise fetch with one emulated ISP command each. The serial is read from
+ * the signature row, where the 1284p keeps its lot and wafer coordinates,
+ * unless an ID has been provisioned at USBASP_EEPROM_SERIAL. It is also
+ * served, in hex, as the USB serial number string */
+#define USBASP_SERIAL_OFFSET    0x0e
+#define USBASP_SERIAL_LEN       10
+
+/* EEPROM reserved by the bootloader, counted down from the top */
+#define USBASP_EEPROM_SERIAL    (E2END + 1 - USBASP_SERIAL_LEN) /* 0xff = not provisioned */
+
+typedef struct __attribute__((packed)) {
+	uint8_t signature[3];
+	uint8_t lfuse;
+	uint8_t hfuse;
+	uint8_t efuse;
+	uint8_t lock;
+	uint8_t osccal;         /* factory calibration byte */
+	uint8_t serial[USBASP_SERIAL_LEN];
+} usbaspIdentity_t;
+
+/* Application fingerprint (USBASP_FUNC_GETFINGERPRINT/SETFINGERPRINT)
+ * At the end of a successful session the host sends SETFINGERPRINT with
+ * wValue = image length in pages (at most the application area) and its build
+ * ID as data. The bootloader hashes that much flash and keeps the record in
+ * EEPROM, where GETFINGERPRINT returns it straight away. Any flash write or
+ * erase, the application's through the service table included, clears the
+ * record, so a host finding a matching fingerprint can skip erase/write/verify. */
+#define USBASP_BUILDID_LEN      8
+#define USBASP_FINGERPRINT_NONE 0xffff  /* pages value of a cleared record */
+
+typedef struct __attribute__((packed)) {
+	uint32_t crc;           /* CRC-32 of the first 'pages' pages of flash */
+	uint16_t pages;
+	uint8_t buildid[USBASP_BUILDID_LEN];
+} usbaspFingerprint_t;
+
+#define USBASP_EEPROM_FINGERPRINT (USBASP_EEPROM_SERIAL - sizeof(usbaspFingerprint_t))
+
+/* A/B application slots (USBASP_FUNC_GETSLOTS/ACTIVATESLOT), only in builds
+ * with BOOT_CFG_AB_SLOTS. Writes and chip erase are limited to the inactive
+ * slot. After uploading, the host sends ACTIVATESLOT with wValue = image
+ * length in pages and the 4 byte little endian CRC-32 of those pages as data.
+ * The bootloader checks the slot against it and only then switches over,
+ * GETSLOTS tells the host whether it did. */
+#define USBASP_SLOT_NONE        0xff
+#define USBASP_SLOT_EMPTY       0xffff  /* pages value of a slot without an image */
+
+typedef struct __attribute__((packed)) {
+	uint8_t active;         /* 0 = slot A, 1 = slot B or USBASP_SLOT_NONE */
+	uint32_t base[2];       /* first byte of each slot */
+	uint32_t crc[2];        /* CRC-32 of each slot's image */
+	uint16_t pages[2];      /* image length in pages */
+} usbaspSlots_t;
+
+#define USBASP_EEPROM_SLOTS     (USBASP_EEPROM_FINGERPRINT - sizeof(usbaspSlots_t))
+
+/* Staged image commit, only in builds with BOOT_CFG_STAGING. The application
+ * stores an image in the staging region, fills in this record with flag =
+ * USBASP_STAGE_COMMIT and progress = 0 and resets. The bootloader checks the
+ * staged pages against crc, copies them into the application area while
+ * journaling progress, and clears the flag when done. */
+#define USBASP_STAGE_COMMIT     0x5a
+
+typedef struct __attribute__((packed)) {
+	uint8_t flag;           /* USBASP_STAGE_COMMIT requests a commit */
+	uint16_t pages;         /* image length in pages */
+	uint32_t crc;           /* CRC-32 of the staged pages */
+	uint16_t progress;      /* pages copied so far */
+} usbaspStage_t;
+
+#define USBASP_EEPROM_STAGE     (USBASP_EEPROM_SLOTS - sizeof(usbaspStage_t))
+
+/* Resumable uploads (USBASP_FUNC_SETSESSION/GETRESUME)
+ * Before a sequential upload the host sends SETSESSION with a 4 byte session
+ * ID and the 4 byte CRC-32 of the whole image as data, both little endian.
+ * If they match the journal, GETRESUME returns the 2 byte little endian page
+ * number the upload can continue from, otherwise 0. Progress is journaled
+ * every USBASP_JOURNAL_INTERVAL pages in a ring of entries to spread the
+ * EEPROM wear.
+ * The journal only records how far the upload got, so resuming is only
+ * correct for an upload that starts at page 0 and writes every page in
+ * order. After anything else (scatter-gather writes, skipped blank ranges,
+ * blocks out of order) the host has to start over. */
+#define USBASP_JOURNAL_ENTRIES  8
+#define USBASP_JOURNAL_INTERVAL 8
+
+typedef struct __attribute__((packed)) {
+	uint8_t seq;            /* the newest entry is followed by a non-consecutive seq */
+	uint32_t session;
+	uint32_t hash;
+	uint16_t page;          /* every page below this one has been written */
+} usbaspJournal_t;
+
+#define USBASP_EEPROM_JOURNAL   (USBASP_EEPROM_STAGE - USBASP_JOURNAL_ENTRIES * sizeof(usbaspJournal_t))
+
+/* Software entry
+ * The application writes USBASP_ENTRY_MAGIC to USBASP_EEPROM_ENTRY and resets
+ * through the watchdog. The bootloader clears the flag and stays resident for
+ * one session as if the reset button had been pressed. */
+#define USBASP_ENTRY_MAGIC      0xb1
+#define USBASP_EEPROM_ENTRY     (USBASP_EEPROM_JOURNAL - 1)
+
+/* Bootloader self-update (USBASP_FUNC_SELFUPDATE)
+ * The new bootloader, padded to the whole boot section, is written to
+ * USBASP_SELFUPDATE_START with the normal write requests. SELFUPDATE then
+ * takes wValue = number of pages and the image's CRC-32 (4 bytes, little
+ * endian) as data. The image has to carry the same copier (see selfupdate.h)
+ * as the running bootloader, the request is refused otherwise. On success the
+ * device leaves the bus and rewrites its boot section, then starts the new
+ * bootloader. The staging area overwrites the top of the application, so this
+ * isn't available in builds with A/B slots or a staging region. */
+#define USBASP_SELFUPDATE_START  0x1C000UL
+#define USBASP_SELFUPDATE_COMMIT 0xa7
+
+typedef struct __attribute__((packed)) {
+	uint8_t flag;           /* USBASP_SELFUPDATE_COMMIT while the copy is due */
+	uint8_t pages;
+} usbaspSelfUpdate_t;
+
+#define USBASP_EEPROM_SELFUPDATE (USBASP_EEPROM_ENTRY - sizeof(usbaspSelfUpdate_t))
+
+/* UART transport (BOOT_CFG_UART)
+ * Every frame is SOF, type, seq, 2 byte little endian payload length, the
+ * payload and a CRC-16 (reflected 0x8408, initial 0xffff, little endian)
+ * over everything after SOF. A SETUP frame carries the 8 byte USB setup
+ * packet of any of the requests above, DATA frames carry the data stage.
+ * Every host frame is answered with ACK (or STALL if refused). The IN data
+ * stage comes before the ACK as at least one DATA frame, the first one with
+ * the seq of the SETUP frame and every further one with the next seq. It
+ * ends with wLength bytes or a frame shorter than USBASP_UART_MAXDATA.
+ * DATA frames must follow the last accepted frame's seq; anything else is
+ * dropped and the last accepted seq is acked again, so the host goes back to
+ * the frame after it. The host may have up to USBASP_UART_WINDOW frames
+ * outstanding, so frames less than USBASP_UART_WINDOW seqs older than the
+ * last accepted one were done already and are only acked again as well.
+ * A SETUP frame with the last accepted seq means its reply got lost. The
+ * request isn't run again, its IN data is sent again instead if it fit in
+ * one DATA frame. Longer IN data is answered with RETRY, the host has to
+ * send the request again under a new seq. */
+#define USBASP_UART_SOF         0x7e
+#define USBASP_UART_SETUP       0x01
+#define USBASP_UART_DATA        0x02
+#define USBASP_UART_ACK         0x81
+#define USBASP_UART_STALL       0x82
+#define USBASP_UART_RETRY       0x83
+
+#define USBASP_UART_HEADERLEN   5
+#define USBASP_UART_MAXDATA     256
+#define USBASP_UART_WINDOW      3
+
+/* HID feature reports (BOOT_CFG_HID)
+ * COMMAND holds a setup packet like the vendor requests above followed by up
+ * to 24 bytes of its data stage. Reading it back returns the reply of the
+ * last command. WRITEPAGE holds a 3 byte little endian flash address, the
+ * block flags and a page of data and writes it like WRITEFLASH_LONG, so
+ * PROG_BLOCKFLAG_SEQUENTIAL erases the next page ahead. READPAGE returns the next
+ * page of the read stream opened by the last command, padded with 0xff. */
+#define USBASP_HID_REPORT_COMMAND   1
+#define USBASP_HID_REPORT_WRITEPAGE 2
+#define USBASP_HID_REPORT_READPAGE  3
+
+#define USBASP_HID_COMMANDLEN   32
+#define USBASP_HID_PAGELEN      256
 
 /* programming state */
 #define PROG_STATE_IDLE         0
@@ -41,10 +257,54 @@
 #define PROG_STATE_WRITEEEPROM  4
 #define PROG_STATE_TPI_READ     5
 #define PROG_STATE_TPI_WRITE    6
+#define PROG_STATE_READFLASH_RLE 7
+#define PROG_STATE_WRITEFLASH_SG 8
+#define PROG_STATE_SETREADLIST   9
+#define PROG_STATE_READFLASH_SG  10
+#define PROG_STATE_SETFINGERPRINT 11
+#define PROG_STATE_ACTIVATESLOT  12
+#define PROG_STATE_SETSESSION    13
+#define PROG_STATE_SELFUPDATE    14
 
 /* Block mode flags */
 #define PROG_BLOCKFLAG_FIRST    1
 #define PROG_BLOCKFLAG_LAST     2
+#define PROG_BLOCKFLAG_SEQUENTIAL 4 /* more pages follow at the next address */
+
+/* RLE readback stream (USBASP_FUNC_READFLASH_RLE)
+ * wValue = address (unless long address mode), wIndex = number of flash
+ * bytes to cover, wLength = maximum number of encoded bytes to return.
+ * Bytes are sent literally, except that a run of USBASP_RLE_MINRUN or more
+ * identical bytes, or any single byte equal to USBASP_RLE_ESCAPE, is sent as
+ * the triple [USBASP_RLE_ESCAPE, count (1..255), value]. A triple is never
+ * split across transfers; the reply ends with a short packet once the flash
+ * range is covered or the next triple would not fit, and the host continues
+ * from the address after the last decoded byte. */
+#define USBASP_RLE_ESCAPE       0xA5
+#define USBASP_RLE_MINRUN       4
+
+/* Long address read/write (USBASP_FUNC_READFLASH_LONG/WRITEFLASH_LONG)
+ * The whole block is described by the setup packet, no SETLONGADDRESS needed:
+ * wValue = address bits 0..15, wIndex low byte = address bits 16..23,
+ * wIndex high byte = block flags, wLength = number of bytes. */
+
+/* On-device verify (USBASP_FUNC_CRC32)
+ * wValue = first page, wIndex = number of pages, returns the 4 byte little
+ * endian CRC-32 (as zlib's crc32()) of that flash range. The range is cut
+ * off at the boot section. Lets a host verify many boards without reading
+ * every image back. */
+
+/* Scatter-gather transfers
+ * USBASP_FUNC_WRITEFLASH_SG carries any number of records in its data stage,
+ * each a 3 byte little endian address, a 2 byte little endian length and
+ * that many data bytes. USBASP_FUNC_SETREADLIST uploads up to
+ * USBASP_SG_MAXRANGES (address, length) records without data, which the
+ * following USBASP_FUNC_READFLASH_SG requests return back to back, each one
+ * continuing where the previous one stopped. A short reply marks the end of
+ * the list, the next request starts it over. wLength is the total payload
+ * size in both directions. */
+#define USBASP_SG_RECORDSIZE    5
+#define USBASP_SG_MAXRANGES     16
 
 /* ISP SCK speed identifiers */
 #define USBASP_ISP_SCK_AUTO   0
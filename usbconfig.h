@@ -20,6 +20,9 @@ recommend that you use that file as a template because it will always list
 the newest features and options.
 */
 
+#include "bootconfig.h"
+#include "usbids.h"
+
 /* ---------------------------- Hardware Config ---------------------------- */
 
 #define USB_CFG_IOPORTNAME      B
@@ -59,9 +62,11 @@ the newest features and options.
 
 /* --------------------------- Functional Range ---------------------------- */
 
-#define USB_CFG_HAVE_INTRIN_ENDPOINT    0
+#define USB_CFG_HAVE_INTRIN_ENDPOINT    (BOOT_CFG_HID || BOOT_CFG_USB_SHARE)
 /* Define this to 1 if you want to compile a version with two endpoints: The
- * default control endpoint 0 and an interrupt-in endpoint 1.
+ * default control endpoint 0 and an interrupt-in endpoint 1. HID requires
+ * the interrupt-in endpoint even though we never send anything on it, a
+ * shared driver offers it to the application.
  */
 #define USB_CFG_HAVE_INTRIN_ENDPOINT3   0
 /* Define this to 1 if you want to compile a version with three endpoints: The
@@ -109,22 +114,31 @@ the newest features and options.
  * of the macros usbDisableAllRequests() and usbEnableAllRequests() in
  * usbdrv.h.
  */
+#define USB_CFG_LONG_TRANSFERS          1
+/* Define this to 1 if you want to send/receive blocks of more than 254 bytes
+ * in a single control-in or control-out transfer. Note that the capability
+ * for long transfers increases the driver size.
+ */
 
 /* -------------------------- Device Description --------------------------- */
 
-#define  USB_CFG_VENDOR_ID  0xc0, 0x16  /* 5824 in dec, stands for VOTI */
+#define  USB_CFG_VENDOR_ID  (USBASP_USB_VID & 0xff), (USBASP_USB_VID >> 8)  /* see usbids.h */
 /* USB vendor ID for the device, low byte first. If you have registered your
  * own Vendor ID, define it here. Otherwise you use obdev's free shared
  * VID/PID pair. Be sure to read USBID-License.txt for rules!
  */
-#define USB_CFG_DEVICE_ID   0xdc, 0x05  /* 1500 in dec, obdev's free PID */
+#if BOOT_CFG_HID
+#define USB_CFG_DEVICE_ID   (USBASP_USB_PID_HID & 0xff), (USBASP_USB_PID_HID >> 8)
+#else
+#define USB_CFG_DEVICE_ID   (USBASP_USB_PID & 0xff), (USBASP_USB_PID >> 8)
+#endif
 /* This is the ID of the product, low byte first. It is interpreted in the
  * scope of the vendor ID. If you have registered your own VID with usb.org
  * or if you have licensed a PID from somebody else, define it here. Otherwise
  * you use obdev's free shared VID/PID pair. Be sure to read the rules in
  * USBID-License.txt!
  */
-#define USB_CFG_DEVICE_VERSION  0x04, 0x01
+#define USB_CFG_DEVICE_VERSION  (USBASP_USB_VERSION & 0xff), (USBASP_USB_VERSION >> 8)
 /* Version number of the device: Minor number first, then major number.
  */
 // #define	USB_CFG_VENDOR_NAME     'w', 'w', 'w', '.', 'f', 'i', 's', 'c', 'h', 'l', '.', 'd', 'e'
@@ -151,17 +165,29 @@ the newest features and options.
  * to fine tune control over USB descriptors such as the string descriptor
  * for the serial number.
  */
+#if BOOT_CFG_HID
+#define USB_CFG_DEVICE_CLASS    0   /* the interface declares the class */
+#else
 #define USB_CFG_DEVICE_CLASS    0xff
+#endif
 #define USB_CFG_DEVICE_SUBCLASS 0
 /* See USB specification if you want to conform to an existing device class.
  */
+#if BOOT_CFG_HID
+#define USB_CFG_INTERFACE_CLASS     3   /* HID */
+#else
 #define USB_CFG_INTERFACE_CLASS     0
+#endif
 #define USB_CFG_INTERFACE_SUBCLASS  0
 #define USB_CFG_INTERFACE_PROTOCOL  0
 /* See USB specification if you want to conform to an existing device class or
  * protocol.
  */
+#if BOOT_CFG_HID
+#define USB_CFG_HID_REPORT_DESCRIPTOR_LENGTH    44  /* total length of report descriptor */
+#else
 #define USB_CFG_HID_REPORT_DESCRIPTOR_LENGTH    0   /* total length of report descriptor */
+#endif
 /* Define this to the length of the HID report descriptor, if you implement
  * an HID device. Otherwise don't define it or define it to 0.
  */
@@ -216,9 +242,14 @@ the newest features and options.
 #define USB_CFG_DESCR_PROPS_STRING_0                (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
 #define USB_CFG_DESCR_PROPS_STRING_VENDOR           (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
 #define USB_CFG_DESCR_PROPS_STRING_PRODUCT          (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
-#define USB_CFG_DESCR_PROPS_STRING_SERIAL_NUMBER    0
+#define USB_CFG_DESCR_PROPS_STRING_SERIAL_NUMBER    (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
+#if BOOT_CFG_HID
+#define USB_CFG_DESCR_PROPS_HID                     (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
+#define USB_CFG_DESCR_PROPS_HID_REPORT              (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
+#else
 #define USB_CFG_DESCR_PROPS_HID                     0
 #define USB_CFG_DESCR_PROPS_HID_REPORT              0
+#endif
 #define USB_CFG_DESCR_PROPS_UNKNOWN                 0
 
 /* ----------------------- Optional MCU Description ------------------------ */
@@ -0,0 +1,30 @@
+/*
+ * usbids.h - part of USBasp bootloader
+ *
+ * Description....: USB IDs and strings of the bootloader
+ * Licence........: GNU GPL v2 (see Readme.txt)
+ * Creation Date..: 2026-10-18
+ * Last change....: 2026-10-18
+ */
+
+#ifndef __usbids_h_included__
+#define __usbids_h_included__
+
+/* Shared by the device descriptors (usbconfig.h, main.c) and the host tools,
+ * which look for these IDs and present them again in usbasp-gadget. Only
+ * defines, usbconfig.h also ends up in V-USB's assembler sources.
+ *
+ * obdev's free shared VID/PID pairs, see USBID-License.txt. Using them
+ * requires the vendor name to contain an Internet domain name. */
+#define USBASP_USB_VID          0x16c0  /* 5824 in dec, stands for VOTI */
+#define USBASP_USB_PID          0x05dc  /* 1500 in dec, obdev's free PID */
+#define USBASP_USB_PID_HID      0x05df  /* 1503 in dec, obdev's free PID for vendor HID */
+#define USBASP_USB_VERSION      0x0104  /* bcdDevice */
+
+/* lists of characters as V-USB's string descriptors take them */
+#define USBASP_USB_VENDOR_NAME      'w', 'w', 'w', '.', 'f', 'i', 's', 'c', 'h', 'l', '.', 'd', 'e'
+#define USBASP_USB_VENDOR_NAME_LEN  13
+#define USBASP_USB_DEVICE_NAME      'U', 'S', 'B', 'a', 's', 'p'
+#define USBASP_USB_DEVICE_NAME_LEN  6
+
+#endif /* __usbids_h_included__ */